@@ -24,16 +24,17 @@
 #include "FragmentProcessor.h"
 #include "Shape.h"
 #include "Renderer.h"
-#include "ObjReader.h"
+#include "MeshFile.h"
 #include "Texture.h"
 #include "FPSTimer.h"
+#include "Presenter.h"
 
 class Application
 {
 public:
 	~Application() {}
 
-	void init(const std::string& name, HINSTANCE instance, int width, int height)
+	bool init(const std::string& name, HINSTANCE instance, int width, int height)
 	{
 		this->instance = instance;
 		this->windowWidth = width;
@@ -57,8 +58,8 @@ public:
 		ShowWindow(window, 1);
 		UpdateWindow(window);
 
-		colorBuffer.init(width, height);
-		initRenderData();
+		colorBuffer.init(width, height, 3);
+		return initRenderData();
 	}
 
 	LRESULT process(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
@@ -151,8 +152,7 @@ public:
 	void render()
 	{
 		processKey();
-		colorBuffer.fill({ 0, 0, 0 });;
-		depthBuffer.fill(1.0f);
+		renderer.clear(adapter, { 0, 0, 0 }, 1.0f);
 		fpsTimer.work();
 
 		if (!cursorDisabled) processKey();
@@ -172,30 +172,23 @@ public:
 		shader.lightStrength = exp(3.0f);
 		shader.tex = &tex;
 		shader.env = &env;
+		shader.ibl = &ibl;
 		shader.lightPos = lightPos;
 		shader.lightColor = lightColor;
 
-		renderer.draw(vb, shader, adapter);
+		// 远处的模型用简化过的LOD，三角形数随屏幕上的大小下降
+		ArrayView<UINT> lodIndices = mesh.lodIndices(mesh.selectLod(camera, model, windowHeight));
+		renderer.draw(mesh.vertices, shader, adapter, &lodIndices);
 
-		flushScreen();
-		adapter.swapBuffers();
+		// 呈现交给presenter线程，swap时提交当前帧并切到下一块空闲缓冲
+		renderer.swapBuffers(adapter);
+		renderer.endFrame();
 	}
 
 private:
-	void initRenderData()
+	bool initRenderData()
 	{
-		ObjReader objReader;
-		std::vector<float> data = objReader.readFile("model/teapot20.obj");
-		std::cout << data.size() << "\n";
-
-		for (int i = 0; i < data.size(); i += 8)
-		{
-			SimpleShader::VSIn vertex;
-			vertex.pos = { data[i + 0], data[i + 1], data[i + 2] };
-			vertex.texCoord = { data[i + 3], data[i + 4] };
-			vertex.norm = { data[i + 5], data[i + 6], data[i + 7] };
-			vb.push_back(vertex);
-		}
+		if (!mesh.load("model/teapot20.obj")) return false;
 
 		model = rotate(model, { 1.0f, 0.0f, 0.0f }, 90.0f);
 
@@ -208,16 +201,22 @@ private:
 		adapter.colorAttachments.push_back(&colorBuffer);
 		adapter.depthAttachment = &depthBuffer;
 
-		Texture::load(tex, "texture/diamond_ore.png");
+		Texture::load(tex, "texture/diamond_ore.png", true);
 		Texture::load(env, "texture/pixel.png");
+		ibl.load(env, "texture/pixel.png.ibl");
 
 		renderer.cullFaceMode = CULL_BACK;
+		renderer.pipelineDepth = 2;
 
 		depthBuffer.init(windowWidth, windowHeight);
-		colorBuffer.init(windowWidth, windowHeight);
+		colorBuffer.init(windowWidth, windowHeight, 3);
+
+		presenter.start([this](FrameBuffer<RGB24>& buf) { flushScreen(buf); });
+		colorBuffer.setPresenter(&presenter);
+		return true;
 	}
 
-	void flushScreen()
+	void flushScreen(FrameBuffer<RGB24>& buf)
 	{
 		BITMAPINFO bInfo;
 		ZeroMemory(&bInfo, sizeof(BITMAPINFO));
@@ -242,7 +241,7 @@ private:
 			compatibleBitmap,
 			0,
 			windowHeight,
-			(BYTE*)colorBuffer.getCurrentBuffer().bufPtr(),
+			(BYTE*)buf.bufPtr(),
 			&bInfo,
 			DIB_RGB_COLORS
 		);
@@ -284,17 +283,19 @@ private:
 
 	FrameBufferDouble<float> depthBuffer;
 	FrameBufferDouble<RGB24> colorBuffer;
+	Presenter<RGB24> presenter;
 	SimpleShader shader;
 	Camera camera = Camera({ 0.0f, -5.0f, 3.0f });
 	FrameBufferAdapter adapter;
 	Renderer renderer;
 	TextureRGB24 tex;
 	TextureRGB24 env;
+	IBL ibl;
 	Vec3 lightPos = { 1.0f, -2.0f, 3.0f };
 	Vec3 lightColor = { 1.0f, 1.0f, 1.0f };
 
 	Mat4 model = Mat4(1.0f);
-	std::vector<SimpleShader::VSIn> vb;
+	Mesh<SimpleShader::VSIn> mesh;
 
 	FPSTimer fpsTimer;
 };
@@ -0,0 +1,165 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+
+const size_t ARENA_OVERFLOW_CHUNK_SIZE = 1 << 20;
+
+// 按帧重置的线性分配器，管线中间数据都从这里分配
+// 一帧内的分配只做指针递增，reset时统一释放；超出容量的部分走溢出块，
+// 并在reset时按历史最高用量扩容，下一帧起不再溢出
+class FrameArena
+{
+public:
+	FrameArena() {}
+
+	FrameArena(size_t capacity)
+	{
+		reserve(capacity);
+	}
+
+	~FrameArena()
+	{
+		releaseOverflow();
+		if (block != nullptr) ::operator delete(block);
+	}
+
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator = (const FrameArena&) = delete;
+
+	void* allocate(size_t bytes, size_t align)
+	{
+		size_t start = offset.load(std::memory_order_relaxed);
+		size_t aligned, end;
+
+		do
+		{
+			aligned = alignUp(start, align);
+			end = aligned + bytes;
+		}
+		while (!offset.compare_exchange_weak(start, end, std::memory_order_relaxed));
+
+		if (end <= capacity) return block + aligned;
+
+		return allocateOverflow(bytes, align);
+	}
+
+	// 只有最后一次分配可以退回，用于vector扩容时原地复用
+	void deallocate(void *ptr, size_t bytes)
+	{
+		char *p = (char*)ptr;
+		if (p < block || p >= block + capacity) return;
+
+		size_t start = p - block;
+		size_t end = start + bytes;
+		offset.compare_exchange_strong(end, start, std::memory_order_relaxed);
+	}
+
+	// 帧结束时调用，此时不能再有存活的中间数据
+	void reset()
+	{
+		highWater = std::max(highWater, offset.load(std::memory_order_relaxed) + overflowPadding);
+		releaseOverflow();
+		offset.store(0, std::memory_order_relaxed);
+
+		if (highWater > capacity) reserve(highWater);
+	}
+
+	void reserve(size_t bytes)
+	{
+		if (bytes <= capacity) return;
+		if (block != nullptr) ::operator delete(block);
+
+		block = (char*)::operator new(bytes);
+		capacity = bytes;
+	}
+
+	size_t used() const { return offset.load(std::memory_order_relaxed); }
+	size_t size() const { return capacity; }
+	size_t highWaterMark() const { return highWater; }
+
+private:
+	static size_t alignUp(size_t x, size_t align)
+	{
+		return (x + align - 1) & ~(align - 1);
+	}
+
+	void* allocateOverflow(size_t bytes, size_t align)
+	{
+		std::lock_guard<std::mutex> lock(overflowMutex);
+
+		size_t aligned = alignUp(overflowOffset, align);
+
+		if (overflow.empty() || aligned + bytes > overflowSize)
+		{
+			overflowSize = std::max(bytes + align, ARENA_OVERFLOW_CHUNK_SIZE);
+			overflow.push_back((char*)::operator new(overflowSize));
+			overflowOffset = 0;
+			aligned = alignUp((size_t)overflow.back(), align) - (size_t)overflow.back();
+		}
+
+		overflowOffset = aligned + bytes;
+		overflowPadding += align;
+
+		return overflow.back() + aligned;
+	}
+
+	void releaseOverflow()
+	{
+		for (auto chunk : overflow) ::operator delete(chunk);
+		overflow.clear();
+		overflowOffset = overflowSize = 0;
+		overflowPadding = 0;
+	}
+
+private:
+	char *block = nullptr;
+	size_t capacity = 0;
+	std::atomic<size_t> offset{ 0 };
+	size_t highWater = 0;
+
+	std::mutex overflowMutex;
+	std::vector<char*> overflow;
+	size_t overflowOffset = 0;
+	size_t overflowSize = 0;
+	size_t overflowPadding = 0;
+};
+
+template<typename T>
+struct ArenaAllocator
+{
+	typedef T value_type;
+
+	ArenaAllocator(FrameArena& arena): arena(&arena) {}
+
+	template<typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other): arena(other.arena) {}
+
+	T* allocate(size_t n)
+	{
+		return (T*)arena->allocate(n * sizeof(T), alignof(T));
+	}
+
+	void deallocate(T *ptr, size_t n)
+	{
+		arena->deallocate(ptr, n * sizeof(T));
+	}
+
+	template<typename U>
+	bool operator == (const ArenaAllocator<U>& other) const { return arena == other.arena; }
+
+	template<typename U>
+	bool operator != (const ArenaAllocator<U>& other) const { return arena != other.arena; }
+
+	FrameArena *arena;
+};
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+#endif
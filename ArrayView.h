@@ -0,0 +1,29 @@
+#ifndef ARRAYVIEW_H
+#define ARRAYVIEW_H
+
+#include <cstddef>
+
+// 不持有内存的连续数组，可指向std::vector、Buffer或映射到内存的文件
+// 提供与std::vector相同的size()与下标访问，可直接作为draw的顶点数组或索引数组
+template<typename T>
+struct ArrayView
+{
+	ArrayView() {}
+	ArrayView(T *data, size_t count): data(data), count(count) {}
+
+	size_t size() { return count; }
+	bool empty() { return count == 0; }
+
+	T& operator [] (size_t index)
+	{
+		return data[index];
+	}
+
+	T* begin() { return data; }
+	T* end() { return data + count; }
+
+	T *data = nullptr;
+	size_t count = 0;
+};
+
+#endif
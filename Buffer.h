@@ -1,10 +1,13 @@
 #ifndef BUFFER_H
 #define BUFFER_H
 
-#include <Windows.h>
+#include <iostream>
 #include <cstdlib>
+#include <cstring>
 #include <algorithm>
 
+#include "Platform.h"
+
 template<typename T>
 struct Buffer
 {
@@ -1,6 +1,8 @@
 #include "Camera.h"
 
-#include <Windows.h>
+#include <cmath>
+
+#include "Platform.h"
 
 #include "math/Vector.h"
 #include "math/Matrix.h"
@@ -114,7 +116,12 @@ Mat4 Camera::viewMatrix()
 
 Mat4 Camera::viewMatrix(Vec3 focus) const
 {
-	Mat4 view = ::lookAt(m_Pos, focus, m_CameraUp);
+	// 视线与up接近平行时叉积退化，换一个与视线不平行的up，同ShadowMap::setLight
+	Vec3 dir = (focus - m_Pos).normalized();
+	Vec3 up = m_CameraUp;
+	if (std::abs(dot(dir, up.normalized())) > 0.99f) up = (std::abs(dir[1]) > 0.99f) ? Vec3{ 1.0f, 0.0f, 0.0f } : Vec3{ 0.0f, 1.0f, 0.0f };
+
+	Mat4 view = ::lookAt(m_Pos, focus, up);
 	return view;
 }
 
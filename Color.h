@@ -1,10 +1,11 @@
 #ifndef COLOR_H
 #define COLOR_H
 
-#include <Windows.h>
 #include <iostream>
 #include <cmath>
+#include <algorithm>
 
+#include "Platform.h"
 #include "math/Vector.h"
 
 struct RGB24
@@ -43,6 +44,11 @@ struct RGB24
 
 struct RGBA32
 {
+	Vec4 toVec4()
+	{
+		return Vec4{ (float)r, (float)g, (float)b, (float)a } / 255.0f;
+	}
+
 	BYTE r, g, b, a;
 };
 
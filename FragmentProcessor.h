@@ -2,37 +2,54 @@
 #define FRAGMENTPROCESSOR_H
 
 #include <vector>
+#include <atomic>
+#include <cstdint>
 
 #include "math/Vector.h"
 #include "math/Matrix.h"
 #include "FrameBufferAdapter.h"
 #include "Shader.h"
+#include "Arena.h"
+
+enum
+{
+	DEPTH_LEQUAL = 0,
+	DEPTH_EQUAL
+} DepthFunc;
 
 class FragmentProcessor
 {
 public:
+	// DEPTH_EQUAL用于深度预pass之后的着色pass：只着色与深度缓冲相等的片元，且不写深度
+	// samples不为空时加上通过深度测试的片元数（遮挡查询），各线程先在本地计数，结束时加一次
 	template<typename Shader>
 	static void processFragment(
 			FrameBufferAdapter& adapter,
 			Shader& shader,
-			std::vector<Pipeline::FSIn<typename Shader::VSToFS>>& fragmentIn)
+			ArenaVector<Pipeline::Quad<typename Shader::VSToFS>>& quads,
+			int depthFunc = DEPTH_LEQUAL,
+			std::atomic<uint64_t> *samples = nullptr)
 	{
+		adapter.depthMask = (depthFunc != DEPTH_EQUAL);
+
 		const int maxThread = 1;std::thread::hardware_concurrency();
 
 		std::thread threads[maxThread];
 		
 		for (int i = 0; i < maxThread; i++)
 		{
-			int start = (fragmentIn.size() / maxThread) * i;
-			int end = std::min(fragmentIn.size(), (fragmentIn.size() / maxThread) * (i + 1));
+			int start = (quads.size() / maxThread) * i;
+			int end = std::min(quads.size(), (quads.size() / maxThread) * (i + 1));
 
 			threads[i] = std::thread
 			(
 				doProcess<Shader>,
 				std::ref(adapter),
 				std::ref(shader),
-				std::ref(fragmentIn),
-				start, end
+				std::ref(quads),
+				start, end,
+				depthFunc,
+				samples
 			);	
 		}
 
@@ -40,6 +57,35 @@ public:
 		{
 			thread.join();
 		}
+
+		adapter.depthMask = true;
+	}
+
+	// 只写深度，不调用着色器；adapter.depthMask为false时只做深度测试
+	static void processDepth(
+			FrameBufferAdapter& adapter,
+			ArenaVector<Pipeline::Quad<Pipeline::NoVaryings>>& quads,
+			std::atomic<uint64_t> *samples = nullptr)
+	{
+		uint64_t passed = 0;
+
+		for (auto& quad : quads)
+		{
+			for (int lane = 0; lane < 4; lane++)
+			{
+				if (!quad.active(lane)) continue;
+
+				adapter.x = quad[lane].x;
+				adapter.y = quad[lane].y;
+
+				if (quad[lane].z > adapter.readDepth()) continue;
+
+				adapter.writeDepth(quad[lane].z);
+				passed++;
+			}
+		}
+
+		if (samples != nullptr) samples->fetch_add(passed, std::memory_order_relaxed);
 	}
 
 private:
@@ -47,19 +93,77 @@ private:
 	static void doProcess(
 			FrameBufferAdapter& adapter,
 			Shader& shader,
-			std::vector<Pipeline::FSIn<typename Shader::VSToFS>>& fragmentIn,
+			ArenaVector<Pipeline::Quad<typename Shader::VSToFS>>& quads,
 			int start,
-			int end)
+			int end,
+			int depthFunc,
+			std::atomic<uint64_t> *samples)
 	{
+		uint64_t passed = 0;
+
 		for (register int i = start; i < end; i++)
 		{
-			adapter.x = fragmentIn[i].x;
-			adapter.y = fragmentIn[i].y;
+			Pipeline::Quad<typename Shader::VSToFS>& quad = quads[i];
+
+			// 先对覆盖的lane做深度测试，未通过的lane降为辅助片元
+			int mask = 0;
+			for (int lane = 0; lane < 4; lane++)
+			{
+				if (!quad.active(lane)) continue;
+
+				adapter.x = quad[lane].x;
+				adapter.y = quad[lane].y;
+
+				float depth = adapter.readDepth();
 
-			if (fragmentIn[i].z > adapter.readDepth()) continue;
+				if (depthFunc == DEPTH_EQUAL)
+				{
+					if (quad[lane].z != depth) continue;
+				}
+				else
+				{
+					if (quad[lane].z > depth) continue;
+					adapter.writeDepth(quad[lane].z);
+				}
+
+				mask |= 1 << lane;
+			}
+
+			if (mask == 0) continue;
+
+			quad.mask = mask;
+			passed += ((mask >> 0) & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1);
+			shadeQuad(adapter, shader, quad, 0);
+		}
+
+		if (samples != nullptr) samples->fetch_add(passed, std::memory_order_relaxed);
+	}
+
+	// 着色器提供以quad为参数的processFragment时整块交给它，否则逐个lane调用
+	template<typename Shader>
+	static auto shadeQuad(
+			FrameBufferAdapter& adapter,
+			Shader& shader,
+			Pipeline::Quad<typename Shader::VSToFS>& quad,
+			int) -> decltype(shader.processFragment(adapter, quad), void())
+	{
+		shader.processFragment(adapter, quad);
+	}
+
+	template<typename Shader>
+	static void shadeQuad(
+			FrameBufferAdapter& adapter,
+			Shader& shader,
+			Pipeline::Quad<typename Shader::VSToFS>& quad,
+			long)
+	{
+		for (int lane = 0; lane < 4; lane++)
+		{
+			if (!quad.active(lane)) continue;
 
-			adapter.writeDepth(fragmentIn[i].z);
-			shader.processFragment(adapter, fragmentIn[i]);
+			adapter.x = quad[lane].x;
+			adapter.y = quad[lane].y;
+			shader.processFragment(adapter, quad[lane]);
 		}
 	}
 };
@@ -7,6 +7,7 @@
 #include "math/Matrix.h"
 #include "FrameBufferDouble.h"
 #include "Color.h"
+#include "PipelineData.h"
 
 struct FrameBufferAdapter
 {
@@ -23,7 +24,7 @@ struct FrameBufferAdapter
 
 	void writeDepth(float val)
 	{
-		if (depthAttachment == nullptr) return;
+		if (depthAttachment == nullptr || !depthMask) return;
 
 		FrameBufferDouble<float> *buf = depthAttachment;
 		if (x < 0 || x >= buf->width() || y < 0 || y >= buf->height()) return;
@@ -31,6 +32,49 @@ struct FrameBufferAdapter
 		(*buf)(x, buf->height() - y - 1) = val;
 	}
 
+	// 浮点附件（G-buffer等），单缓冲，不参与交换与清屏
+	void writeFloat(int index, Vec4 value)
+	{
+		if (index >= floatAttachments.size() || index < 0) return;
+		if (floatAttachments[index] == nullptr) return;
+
+		FrameBuffer<Vec4> *buf = floatAttachments[index];
+		if (x < 0 || x >= buf->width || y < 0 || y >= buf->height) return;
+
+		(*buf)(x, buf->height - y - 1) = value;
+	}
+
+	Vec4 readFloat(int index)
+	{
+		if (index >= floatAttachments.size() || index < 0) return Vec4(0.0f);
+		if (floatAttachments[index] == nullptr) return Vec4(0.0f);
+
+		FrameBuffer<Vec4> *buf = floatAttachments[index];
+		if (x < 0 || x >= buf->width || y < 0 || y >= buf->height) return Vec4(0.0f);
+
+		return (*buf)(x, buf->height - y - 1);
+	}
+
+	void writeVisibility(UINT id)
+	{
+		if (visibilityAttachment == nullptr) return;
+
+		FrameBuffer<UINT> *buf = visibilityAttachment;
+		if (x < 0 || x >= buf->width || y < 0 || y >= buf->height) return;
+
+		(*buf)(x, buf->height - y - 1) = id;
+	}
+
+	UINT readVisibility()
+	{
+		if (visibilityAttachment == nullptr) return VISIBILITY_EMPTY;
+
+		FrameBuffer<UINT> *buf = visibilityAttachment;
+		if (x < 0 || x >= buf->width || y < 0 || y >= buf->height) return VISIBILITY_EMPTY;
+
+		return (*buf)(x, buf->height - y - 1);
+	}
+
 	float readDepth()
 	{
 		if (depthAttachment == nullptr) return 1.0f;
@@ -41,6 +85,32 @@ struct FrameBufferAdapter
 		return (*buf)(x, buf->height() - y - 1);
 	}
 
+	void clear(RGB24 color, float depth)
+	{
+		for (auto buf : colorAttachments)
+		{
+			buf->fill(color);
+		}
+
+		if (depthAttachment)
+		{
+			depthAttachment->fill(depth);
+		}
+
+		if (visibilityAttachment)
+		{
+			visibilityAttachment->fill(VISIBILITY_EMPTY);
+		}
+
+		clearDepth = depth;
+	}
+
+	// 深度小于清屏值即本帧被几何覆盖过，延迟着色的光照阶段据此跳过背景
+	bool covered()
+	{
+		return readDepth() < clearDepth;
+	}
+
 	void swapBuffers()
 	{
 		for (auto buf : colorAttachments)
@@ -56,6 +126,12 @@ struct FrameBufferAdapter
 
 	std::vector<FrameBufferDouble<RGB24>*> colorAttachments;
 	FrameBufferDouble<float> *depthAttachment = nullptr;
+	std::vector<FrameBuffer<Vec4>*> floatAttachments;
+	// 可见性缓冲，存drawId | 三角形序号
+	FrameBuffer<UINT> *visibilityAttachment = nullptr;
+	float clearDepth = 1.0f;
+	// 为false时writeDepth不生效，类似glDepthMask
+	bool depthMask = true;
 	int x, y;
 };
 
@@ -2,63 +2,84 @@
 #define FRAMEBUFFERDOUBLE_H
 
 #include "FrameBuffer.h"
+#include "Presenter.h"
 
+const int FRAMEBUFFER_MAX_COUNT = 3;
+
+// 默认双缓冲；init时count传3并设置presenter即为三缓冲+异步呈现
 template<typename T>
 class FrameBufferDouble
 {
 public:
 	FrameBufferDouble() {}
 
-	FrameBufferDouble(int w, int h)
+	FrameBufferDouble(int w, int h, int count = 2)
 	{
-		init(w, h);
+		init(w, h, count);
 	}
 
-	void init(int w, int h)
+	void init(int w, int h, int count = 2)
 	{
-		buf[0].init(w, h);
-		buf[1].init(w, h);
+		this->count = std::min(std::max(count, 1), FRAMEBUFFER_MAX_COUNT);
+		for (int i = 0; i < this->count; i++) buf[i].init(w, h);
 	}
 
 	void release()
 	{
-		buf[0].release();
-		buf[1].release();
+		for (int i = 0; i < count; i++) buf[i].release();
 	}
 
 	void resize(int w, int h)
 	{
-		buf[0].resize(w, h);
-		buf[1].resize(w, h);
+		for (int i = 0; i < count; i++) buf[i].resize(w, h);
+	}
+
+	// 直接渲染到外部的缓冲（如纹理），此时只有这一块，swap无效果
+	void wrap(FrameBuffer<T> *target)
+	{
+		external = target;
 	}
 
 	void fill(T val)
 	{
-		buf[index].fill(val);
+		getCurrentBuffer().fill(val);
 	}
 
-	int width() { return buf[0].width; }
-	int height() { return buf[0].height; }
+	int width() { return (external != nullptr) ? external->width : buf[0].width; }
+	int height() { return (external != nullptr) ? external->height : buf[0].height; }
 
 	T& operator () (int i, int j)
 	{
-		return buf[index](i, j);
+		return getCurrentBuffer()(i, j);
 	}
 
 	FrameBuffer<T>& getCurrentBuffer()
 	{
-		return buf[index];
+		return (external != nullptr) ? *external : buf[index];
+	}
+
+	void setPresenter(Presenter<T> *presenter)
+	{
+		this->presenter = presenter;
 	}
 
+	// 有presenter时把当前缓冲提交呈现，并等待下一块缓冲空闲
 	void swap()
 	{
-		index ^= 1;
+		if (external != nullptr) return;
+		if (presenter != nullptr) presenter->submit(&buf[index]);
+
+		index = (index + 1) % count;
+
+		if (presenter != nullptr) presenter->wait(&buf[index]);
 	}
 
 private:
-	FrameBuffer<T> buf[2];
+	FrameBuffer<T> buf[FRAMEBUFFER_MAX_COUNT];
+	int count = 2;
 	int index = 0;
+	Presenter<T> *presenter = nullptr;
+	FrameBuffer<T> *external = nullptr;
 };
 
 #endif
-
@@ -0,0 +1,632 @@
+#ifndef HEADLESSAPPLICATION_H
+#define HEADLESSAPPLICATION_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <cmath>
+
+#include "math/Vector.h"
+#include "math/Matrix.h"
+#include "Color.h"
+#include "FrameBuffer.h"
+#include "FrameBufferDouble.h"
+#include "FrameBufferAdapter.h"
+#include "Presenter.h"
+#include "Camera.h"
+#include "Shader.h"
+#include "Renderer.h"
+#include "ShadowMap.h"
+#include "MeshFile.h"
+#include "Scene.h"
+#include "OcclusionCuller.h"
+#include "Texture.h"
+#include "ImageWriter.h"
+
+struct HeadlessOptions
+{
+	bool parse(int argc, char **argv)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			std::string arg = argv[i];
+			bool hasValue = i + 1 < argc;
+
+			if (arg == "-h" || arg == "--help") return false;
+			if (!hasValue)
+			{
+				std::cout << "Missing value for " << arg << std::endl;
+				return false;
+			}
+
+			std::string value = argv[++i];
+
+			if (arg == "-m" || arg == "--model") modelPath = value;
+			else if (arg == "-t" || arg == "--texture") texturePath = value;
+			else if (arg == "-o" || arg == "--output") outputPath = value;
+			else if (arg == "-n" || arg == "--frames") frameCount = std::max(1, atoi(value.c_str()));
+			else if (arg == "--pipeline") pipelineDepth = std::max(0, atoi(value.c_str()));
+			else if (arg == "--compress") compressTextures = (value != "0");
+			else if (arg == "--quantize") quantizeVertices = (value != "0");
+			else if (arg == "--instances") instanceCount = std::max(0, atoi(value.c_str()));
+			else if (arg == "--occluders") occluderCount = std::max(0, atoi(value.c_str()));
+			else if (arg == "--queries") occlusionQueries = (value != "0");
+			else if (arg == "--lod") lodPixelError = std::max(0.0f, (float)atof(value.c_str()));
+			else if (arg == "--deferred") deferred = (value != "0");
+			else if (arg == "--prepass") depthPrepass = (value != "0");
+			else if (arg == "--visibility") visibilityBuffer = (value != "0");
+			else if (arg == "--lights") lightCount = std::max(0, atoi(value.c_str()));
+			else if (arg == "--env") envPath = value;
+			else if (arg == "--shadow") shadowSize = std::max(0, atoi(value.c_str()));
+			else if (arg == "--light")
+			{
+				if (!parseVec3(value, lightPos)) return false;
+				fixedLight = true;
+			}
+			else if (arg == "-s" || arg == "--size")
+			{
+				if (sscanf(value.c_str(), "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0)
+				{
+					std::cout << "Bad size: " << value << std::endl;
+					return false;
+				}
+			}
+			else if (arg == "-f" || arg == "--format")
+			{
+				if (value == "ppm") format = IMAGE_PPM;
+				else if (value == "png") format = IMAGE_PNG;
+				else if (value == "raw") format = IMAGE_RAW;
+				else
+				{
+					std::cout << "Unknown format: " << value << std::endl;
+					return false;
+				}
+			}
+			else if (arg == "--path")
+			{
+				// 关键点用冒号分隔，如 0,-5,3:5,0,3:0,5,3
+				size_t start = 0;
+				while (start <= value.size())
+				{
+					size_t end = value.find(':', start);
+					if (end == std::string::npos) end = value.size();
+
+					Vec3 p;
+					if (!parseVec3(value.substr(start, end - start), p)) return false;
+					cameraPath.push_back(p);
+
+					start = end + 1;
+				}
+			}
+			else if (arg == "--target")
+			{
+				if (!parseVec3(value, target)) return false;
+			}
+			else if (arg == "--orbit")
+			{
+				if (sscanf(value.c_str(), "%f,%f", &orbitRadius, &orbitHeight) != 2)
+				{
+					std::cout << "Bad orbit: " << value << std::endl;
+					return false;
+				}
+			}
+			else
+			{
+				std::cout << "Unknown option: " << arg << std::endl;
+				return false;
+			}
+		}
+
+		// 机位与目标重合时视线方向无定义
+		for (auto& p : cameraPath)
+		{
+			if (length(p - target) < 1e-4f)
+			{
+				std::cout << "Camera path point coincides with the target: " << p[0] << "," << p[1] << "," << p[2] << std::endl;
+				return false;
+			}
+		}
+		if (cameraPath.empty() && std::abs(orbitRadius) < 1e-4f && std::abs(orbitHeight) < 1e-4f)
+		{
+			std::cout << "Orbit radius and height are both zero, the camera would sit on the target" << std::endl;
+			return false;
+		}
+
+		if (outputPath != "-" && !validPattern(outputPath))
+		{
+			std::cout << "Bad output pattern: " << outputPath << " (at most one %d-style conversion, use %% for a literal %)" << std::endl;
+			return false;
+		}
+
+		if (format == -1) format = ImageWriter::formatFromPath(outputPath);
+		return true;
+	}
+
+	static void printUsage(const char *name)
+	{
+		std::cout
+			<< "Usage: " << name << " [options]\n"
+			<< "  -m, --model <file.obj>      model to render (default model/teapot2.obj)\n"
+			<< "  -t, --texture <file>        albedo texture (default white)\n"
+			<< "  -o, --output <pattern>      output file, printf pattern for the frame number\n"
+			<< "                              (default frame_%04d.ppm), '-' writes to stdout\n"
+			<< "  --compress <0|1>            keep the texture BC1-compressed (default 0)\n"
+			<< "  --quantize <0|1>            store vertices as 16-bit quantized attributes, cached as <obj>.q.mesh (default 0)\n"
+			<< "  --lod <pixels>              pick the coarsest LOD whose error stays under this many pixels,\n"
+			<< "                              0 always draws the full mesh (default 0)\n"
+			<< "  --instances <count>         draw the model this many times in a grid with varied materials,\n"
+			<< "                              as one instanced draw (default 0, a single plain draw)\n"
+			<< "  --occluders <count>         use this many nearest instances as occluders and skip\n"
+			<< "                              instances hidden behind them (default 0)\n"
+			<< "  --queries <0|1>             skip instances whose bounding box was hidden in an earlier frame,\n"
+			<< "                              using occlusion queries on box proxies (default 0)\n"
+			<< "  --deferred <0|1>            shade through a G-buffer, once per pixel (default 0)\n"
+			<< "  --prepass <0|1>             fill depth first, then shade visible fragments only (default 0)\n"
+			<< "  --visibility <0|1>          rasterize triangle ids, shade visible pixels afterwards (default 0)\n"
+			<< "  --lights <count>            extra small point lights around the target, culled per tile (default 0)\n"
+			<< "  --env <file>                environment map for image-based ambient lighting,\n"
+			<< "                              precomputed tables are cached next to it as <file>.ibl\n"
+			<< "  --shadow <size>             shadow map resolution for the main light, 0 disables (default 0)\n"
+			<< "  --light <x,y,z>             fixed main light position (default follows the camera)\n"
+			<< "  -f, --format <ppm|png|raw>  output format (default from extension)\n"
+			<< "  -n, --frames <count>        number of frames (default 1)\n"
+			<< "  -s, --size <WxH>            image size (default 256x256)\n"
+			<< "  --pipeline <depth>          draws in flight between vertex and fragment stages,\n"
+			<< "                              0 renders each draw synchronously (default 4)\n"
+			<< "  --path <x,y,z:x,y,z:...>    camera positions, interpolated over the frames\n"
+			<< "  --orbit <radius,height>     orbit around the target when no path is given\n"
+			<< "  --target <x,y,z>            point the camera looks at (default 0,0,0)\n";
+	}
+
+	// 输出路径会作为snprintf的格式串，只允许%%与至多一个带可选标志、宽度与精度的%d或%i
+	static bool validPattern(const std::string& pattern)
+	{
+		int conversions = 0;
+		for (size_t i = 0; i < pattern.size(); i++)
+		{
+			if (pattern[i] != '%') continue;
+			if (++i < pattern.size() && pattern[i] == '%') continue;
+
+			while (i < pattern.size() && strchr("-+ #0", pattern[i]) != nullptr) i++;
+			while (i < pattern.size() && isdigit((unsigned char)pattern[i])) i++;
+			if (i < pattern.size() && pattern[i] == '.')
+			{
+				i++;
+				while (i < pattern.size() && isdigit((unsigned char)pattern[i])) i++;
+			}
+
+			if (i >= pattern.size() || (pattern[i] != 'd' && pattern[i] != 'i')) return false;
+			conversions++;
+		}
+		return conversions <= 1;
+	}
+
+	static bool parseVec3(const std::string& str, Vec3& v)
+	{
+		if (sscanf(str.c_str(), "%f,%f,%f", &v[0], &v[1], &v[2]) != 3)
+		{
+			std::cout << "Bad vector: " << str << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	std::string modelPath = "model/teapot2.obj";
+	std::string texturePath;
+	std::string envPath;
+	std::string outputPath = "frame_%04d.ppm";
+	int format = -1;
+	int width = 256;
+	int height = 256;
+	int frameCount = 1;
+	int pipelineDepth = 4;
+	bool compressTextures = false;
+	bool quantizeVertices = false;
+	float lodPixelError = 0.0f;
+	int instanceCount = 0;
+	int occluderCount = 0;
+	bool occlusionQueries = false;
+	bool deferred = false;
+	bool depthPrepass = false;
+	bool visibilityBuffer = false;
+	int lightCount = 0;
+	int shadowSize = 0;
+	bool fixedLight = false;
+	Vec3 lightPos = Vec3(0.0f);
+
+	std::vector<Vec3> cameraPath;
+	Vec3 target = Vec3(0.0f);
+	float orbitRadius = 5.0f;
+	float orbitHeight = 3.0f;
+};
+
+// 不依赖窗口与GDI的渲染循环：渲染到离屏的FrameBufferAdapter，
+// 由presenter线程编码写出上一帧，与下一帧的渲染重叠
+class HeadlessApplication
+{
+public:
+	bool init(HeadlessOptions& options)
+	{
+		this->options = options;
+
+		if (options.outputPath == "-")
+		{
+			// 帧数据独占stdout，日志改走stderr
+			stream = new std::ostream(std::cout.rdbuf());
+			std::cout.rdbuf(std::cerr.rdbuf());
+		}
+
+		if (!mesh.load(options.modelPath.c_str(), options.quantizeVertices)) return false;
+
+		model = rotate(model, { 1.0f, 0.0f, 0.0f }, 90.0f);
+
+		// 实例排成以目标为中心的方阵，间距按包围球取，材质按色相与粗糙度轮换
+		int columns = (int)std::ceil(std::sqrt((float)options.instanceCount));
+		float spacing = mesh.boundingRadius() * 2.5f;
+		for (int i = 0; i < options.instanceCount; i++)
+		{
+			Vec3 offset = options.target + Vec3{ (i % columns - (columns - 1) * 0.5f) * spacing, (i / columns - (columns - 1) * 0.5f) * spacing, 0.0f };
+			Mat4 identity = Mat4(1.0f);
+			float hue = toRad(137.5f * i);
+
+			SimpleShader::Instance instance;
+			instance.model = translate(identity, offset) * model;
+			instance.albedo = { 0.6f + 0.4f * std::cos(hue), 0.6f + 0.4f * std::cos(hue + 2.1f), 0.6f + 0.4f * std::cos(hue + 4.2f) };
+			instance.metallic = 0.0f;
+			instance.roughness = 0.3f + 0.7f * (i % 4) / 3.0f;
+			instances.push_back(instance);
+			scene.add(i, Bounds::sphere(mesh.boundingCenter(), mesh.boundingRadius()), instance.model);
+		}
+
+		if (options.occlusionQueries) queries = std::vector<OcclusionQuery>(options.instanceCount);
+		occlusion.init(options.width / OCCLUSION_DOWNSCALE, options.height / OCCLUSION_DOWNSCALE);
+
+		camera.setFOV(75.0f);
+		camera.setPlanes(0.1f, 100.0f);
+
+		if (options.texturePath.empty())
+		{
+			tex.init(1, 1);
+			tex.fill({ 255, 255, 255 });
+		}
+		else if (options.compressTextures) Texture::loadCompressed(compressedTex, options.texturePath.c_str());
+		else Texture::load(tex, options.texturePath.c_str(), true);
+
+		depthBuffer.init(options.width, options.height);
+		colorBuffer.init(options.width, options.height, 3);
+
+		adapter.colorAttachments.push_back(&colorBuffer);
+		adapter.depthAttachment = &depthBuffer;
+
+		if (options.deferred)
+		{
+			for (int i = 0; i < SimpleShader::GBUFFER_COUNT; i++)
+			{
+				gBuffer[i].init(options.width, options.height);
+				adapter.floatAttachments.push_back(&gBuffer[i]);
+			}
+		}
+
+		if (options.visibilityBuffer)
+		{
+			visibility.init(options.width, options.height);
+			adapter.visibilityAttachment = &visibility;
+		}
+
+		// 附加光源均匀撒在目标周围的球壳上，颜色按色相轮换
+		for (int i = 0; i < options.lightCount; i++)
+		{
+			float t = (i + 0.5f) / options.lightCount;
+			float theta = toRad(137.5f * i), z = 1.0f - 2.0f * t;
+			float r = std::sqrt(1.0f - z * z);
+
+			PointLight light;
+			light.pos = options.target + Vec3{ r * std::cos(theta), r * std::sin(theta), z } * 3.0f;
+			light.color = Vec3{ 0.5f + 0.5f * std::cos(theta), 0.5f + 0.5f * std::cos(theta + 2.1f), 0.5f + 0.5f * std::cos(theta + 4.2f) } * 3.0f;
+			light.radius = 1.5f;
+			pointLights.push_back(light);
+		}
+
+		if (!options.envPath.empty())
+		{
+			// Texture::load读不到文件会直接退出，先检查一遍，失败时也不写缓存
+			if (!std::ifstream(options.envPath, std::ios::binary))
+			{
+				std::cout << "Cannot open environment map: " << options.envPath << std::endl;
+				return false;
+			}
+
+			Texture::load(env, options.envPath.c_str());
+			if (!ibl.load(env, options.envPath + ".ibl")) return false;
+		}
+
+		if (options.shadowSize > 0) shadowMap.init(options.shadowSize);
+
+		renderer.cullFaceMode = CULL_BACK;
+		renderer.pipelineDepth = options.pipelineDepth;
+		renderer.depthPrepass = options.depthPrepass;
+
+		presenter.start([this](FrameBuffer<RGB24>& buf) { writeFrame(buf); });
+		colorBuffer.setPresenter(&presenter);
+
+		return true;
+	}
+
+	void run()
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		for (int frame = 0; frame < options.frameCount; frame++)
+		{
+			renderer.clear(adapter, { 0, 0, 0 }, 1.0f);
+
+			Vec3 cameraPos = cameraPosition(frame);
+			camera.setPos(cameraPos);
+
+			shader.model = model;
+			shader.view = camera.viewMatrix(options.target);
+			shader.proj = camera.projMatrix(options.width, options.height);
+			shader.albedo = { 1.0f, 0.6f, 0.4f };
+			shader.metallic = 0.0f;
+			shader.roughness = 1.0f;
+			shader.ao = 0.1f;
+			shader.viewPos = cameraPos;
+			shader.lightStrength = exp(3.0f);
+			shader.tex = &tex;
+			shader.ibl = ibl.ready() ? &ibl : nullptr;
+			shader.compressedTex = (compressedTex.levels > 0) ? &compressedTex : nullptr;
+			shader.lightPos = options.fixedLight ? options.lightPos : cameraPos + Vec3{ 1.0f, 0.0f, 1.0f };
+			shader.lightColor = { 1.0f, 1.0f, 1.0f };
+			shader.deferred = options.deferred;
+			shader.lightGrid = nullptr;
+			shader.shadow = ShadowSampler();
+
+			// 场景剔除：视锥内的实例按从近到远排列，组成本帧的实例数组
+			visible.clear();
+			visibleIds.clear();
+			if (!instances.empty())
+			{
+				scene.cull(shader.view, shader.proj, drawList);
+
+				// 最近的几个实例作为遮挡物，其余的先与遮挡深度比较
+				int occluders = std::min((int)drawList.size(), options.occluderCount);
+				if (occluders > 0)
+				{
+					occlusion.begin(shader.view, shader.proj);
+					for (int i = 0; i < occluders; i++) occlusion.addOccluder(mesh.vertices, scene.transform(drawList[i].id), &mesh.indices);
+					occlusion.buildPyramid();
+				}
+
+				for (int i = 0; i < drawList.size(); i++)
+				{
+					if (i >= occluders && occlusion.occluded(scene.bounds(drawList[i].id)))
+					{
+						occludedInstances++;
+						continue;
+					}
+					visible.push_back(instances[scene.object(drawList[i].id)]);
+					visibleIds.push_back(drawList[i].id);
+				}
+				visibleInstances += visible.size();
+			}
+
+			// 实例共用一份索引，取各可见实例所需LOD中最精细的一级
+			int lod = (options.lodPixelError > 0.0f) ? mesh.selectLod(camera, model, options.height, options.lodPixelError) : 0;
+			if (options.lodPixelError > 0.0f && !visible.empty())
+			{
+				lod = MESH_MAX_LODS - 1;
+				for (auto& instance : visible) lod = std::min(lod, mesh.selectLod(camera, instance.model, options.height, options.lodPixelError));
+			}
+			ArrayView<UINT> lodIndices = mesh.lodIndices(lod);
+			lodFrames[lod]++;
+
+			if (options.shadowSize > 0)
+			{
+				// 阴影贴图与其他draw同序渲染，着色器按值保存光源矩阵
+				shadowMap.setLight(shader.lightPos, options.target, 60.0f, 0.5f, 50.0f);
+				shadowMap.clear(renderer);
+				if (instances.empty()) shadowMap.render(renderer, mesh.vertices, model, &lodIndices);
+				for (auto& instance : instances) shadowMap.render(renderer, mesh.vertices, instance.model, &lodIndices);
+				shader.shadow = shadowMap.sampler();
+			}
+
+			if (!pointLights.empty())
+			{
+				// 先画深度，再按深度范围剔除光源，之后的着色只看所在块的光源
+				if (instances.empty()) renderer.drawDepth(mesh.vertices, shader, adapter, &lodIndices);
+				for (int i = 0; i < visible.size(); i++)
+				{
+					SimpleShader local = shader;
+					local.model = visible[i].model;
+					beginCondition(visibleIds[i]);
+					renderer.drawDepth(mesh.vertices, local, adapter, &lodIndices);
+					endCondition();
+				}
+
+				Mat4 view = shader.view, proj = shader.proj;
+				renderer.submit([this, view, proj]() { lightGrid.cull(pointLights, view, proj, adapter); });
+				shader.lightGrid = &lightGrid;
+			}
+
+			if (options.visibilityBuffer)
+			{
+				// 可见性缓冲按draw记录着色器，实例逐个提交，包围盒查询没有片元露出的由Renderer条件渲染跳过
+				if (instances.empty()) renderer.drawVisibility(mesh.vertices, shader, adapter, &lodIndices);
+				for (int i = 0; i < visible.size(); i++)
+				{
+					SimpleShader local = shader;
+					local.model = visible[i].model;
+					local.albedo = visible[i].albedo;
+					local.metallic = visible[i].metallic;
+					local.roughness = visible[i].roughness;
+
+					if (beginCondition(visibleIds[i])) queryCulledInstances++;
+					renderer.drawVisibility(mesh.vertices, local, adapter, &lodIndices);
+					endCondition();
+				}
+				renderer.resolveVisibility(adapter);
+			}
+			else
+			{
+				if (instances.empty()) renderer.draw(mesh.vertices, shader, adapter, &lodIndices);
+				else
+				{
+					// 实例合成一次draw，无法逐个条件渲染，在这里直接去掉查询结果为被遮挡的实例
+					unhidden.clear();
+					for (int i = 0; i < visible.size(); i++)
+					{
+						if (!queries.empty() && queries[visibleIds[i]].occluded()) queryCulledInstances++;
+						else unhidden.push_back(visible[i]);
+					}
+					renderer.drawInstanced(mesh.vertices, shader, adapter, unhidden, &lodIndices);
+				}
+				if (options.deferred) renderer.resolve(shader, adapter);
+			}
+
+			// 视锥内每个实例画一个包围盒代理，结果决定之后的帧是否画它；画完所有物体后再查询，深度已是最终的
+			if (!queries.empty())
+			{
+				Mat4 viewProj = shader.proj * shader.view;
+				for (auto& draw : drawList)
+				{
+					renderer.beginQuery(queries[draw.id]);
+					renderer.drawBoundingBox(scene.bounds(draw.id), viewProj, adapter);
+					renderer.endQuery();
+				}
+			}
+
+			renderer.swapBuffers(adapter);
+			renderer.endFrame();
+		}
+
+		renderer.finish();
+		presenter.stop();
+
+		float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+		if (options.lodPixelError > 0.0f)
+		{
+			std::cout << "LOD frames:";
+			for (int i = 0; i < mesh.lodCount(); i++) std::cout << " " << lodFrames[i];
+			std::cout << std::endl;
+		}
+
+		if (!instances.empty())
+		{
+			std::cout << "Visible instances: " << (float)(visibleInstances - queryCulledInstances) / options.frameCount
+				<< " of " << instances.size() << " per frame, "
+				<< (float)occludedInstances / options.frameCount << " occluded, "
+				<< (float)queryCulledInstances / options.frameCount << " skipped by queries" << std::endl;
+		}
+
+		std::cout << "Rendered " << options.frameCount << " frames in " << seconds << " s ("
+			<< options.frameCount / seconds << " FPS)" << std::endl;
+	}
+
+	~HeadlessApplication()
+	{
+		presenter.stop();
+
+		if (stream != nullptr)
+		{
+			std::cout.rdbuf(stream->rdbuf());
+			delete stream;
+		}
+	}
+
+private:
+	// 实例有遮挡查询时，之后的draw由Renderer按查询结果条件渲染，返回这次是否会被跳过
+	bool beginCondition(int id)
+	{
+		if (queries.empty()) return false;
+
+		renderer.beginConditionalRender(queries[id]);
+		return queries[id].occluded();
+	}
+
+	void endCondition()
+	{
+		if (!queries.empty()) renderer.endConditionalRender();
+	}
+
+	Vec3 cameraPosition(int frame)
+	{
+		std::vector<Vec3>& path = options.cameraPath;
+		float t = options.frameCount > 1 ? (float)frame / (options.frameCount - 1) : 0.0f;
+
+		if (path.size() == 1) return path[0];
+		if (path.size() > 1)
+		{
+			float segment = t * (path.size() - 1);
+			int i = std::min((int)segment, (int)path.size() - 2);
+			return lerp(path[i], path[i + 1], segment - i);
+		}
+
+		// 没有给路径时绕目标转一圈，第0帧与窗口版的初始机位一致
+		float angle = toRad(-90.0f + 360.0f * frame / options.frameCount);
+		return options.target + Vec3{ options.orbitRadius * std::cos(angle), options.orbitRadius * std::sin(angle), options.orbitHeight };
+	}
+
+	void writeFrame(FrameBuffer<RGB24>& buf)
+	{
+		if (stream != nullptr)
+		{
+			ImageWriter::write(*stream, buf, options.format);
+			stream->flush();
+		}
+		else
+		{
+			char path[1024];
+			snprintf(path, sizeof(path), options.outputPath.c_str(), framesWritten);
+			ImageWriter::write(std::string(path), buf, options.format);
+		}
+		framesWritten++;
+	}
+
+private:
+	HeadlessOptions options;
+
+	FrameBufferDouble<float> depthBuffer;
+	FrameBufferDouble<RGB24> colorBuffer;
+	FrameBuffer<Vec4> gBuffer[SimpleShader::GBUFFER_COUNT];
+	FrameBuffer<UINT> visibility;
+	Presenter<RGB24> presenter;
+	std::ostream *stream = nullptr;
+	int framesWritten = 0;
+
+	SimpleShader shader;
+	Camera camera;
+	FrameBufferAdapter adapter;
+	Renderer renderer;
+	TextureRGB24 tex;
+	TextureBC1 compressedTex;
+
+	std::vector<PointLight> pointLights;
+	LightGrid lightGrid;
+	ShadowMap shadowMap;
+	TextureRGB24 env;
+	IBL ibl;
+
+	Mat4 model = Mat4(1.0f);
+	std::vector<SimpleShader::Instance> instances;
+	// 实例按编号放入场景，每帧剔除后按从近到远的顺序取出可见的
+	Scene<int> scene;
+	std::vector<Scene<int>::Draw> drawList;
+	std::vector<SimpleShader::Instance> visible;
+	std::vector<int> visibleIds;
+	std::vector<SimpleShader::Instance> unhidden;
+	size_t visibleInstances = 0;
+	size_t occludedInstances = 0;
+	size_t queryCulledInstances = 0;
+	// 每个实例一个遮挡查询，按场景中的编号索引
+	std::vector<OcclusionQuery> queries;
+	OcclusionCuller occlusion;
+	Mesh<SimpleShader::VSIn> mesh;
+	int lodFrames[MESH_MAX_LODS] = {};
+};
+
+#endif
@@ -0,0 +1,459 @@
+#ifndef IBL_H
+#define IBL_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+#include "math/Vector.h"
+#include "Color.h"
+#include "FrameBuffer.h"
+#include "Texture.h"
+
+const int IBL_IRRADIANCE_WIDTH = 32;
+const int IBL_IRRADIANCE_HEIGHT = 16;
+const int IBL_SPECULAR_WIDTH = 128;
+const int IBL_SPECULAR_HEIGHT = 64;
+const int IBL_SPECULAR_LEVELS = 5;
+const int IBL_SPECULAR_SAMPLES = 128;
+const int IBL_BRDF_SIZE = 32;
+const int IBL_BRDF_SAMPLES = 256;
+// 卷积irradiance时源图缩到不超过这个宽度，积分量与环境图大小无关
+const int IBL_IRRADIANCE_SOURCE_WIDTH = 64;
+// 参数或算法改变时加一，旧的缓存文件随之失效
+const uint32_t IBL_CACHE_VERSION = 1;
+
+inline Vec3 mipAverage(Vec3& a, Vec3& b, Vec3& c, Vec3& d)
+{
+	return (a + b + c + d) * 0.25f;
+}
+
+// 基于图像的环境光照：载入时把经纬度格式的环境图预计算成三张表
+// irradiance：漫反射用的余弦卷积；specular：按粗糙度分级的GGX预滤波mip链；brdf：split-sum的(scale, bias)
+// 着色时只做查表，不做任何积分；结果按环境图内容缓存到磁盘
+// 方向与经纬度的对应以z轴朝上，u为方位角，v=0为正上方
+class IBL
+{
+public:
+	// 缓存文件存在且与env内容、参数一致时直接读取，否则预计算后写入cachePath
+	// env为空（环境图没能载入）时返回false，不写缓存
+	bool load(TextureRGB24& env, const std::string& cachePath)
+	{
+		if (env.width <= 0 || env.height <= 0)
+		{
+			std::cout << "Empty environment map for IBL: " << cachePath << std::endl;
+			return false;
+		}
+
+		uint64_t key = hashEnvironment(env);
+
+		if (readCache(cachePath, key))
+		{
+			std::cout << "IBL loaded from cache: " << cachePath << std::endl;
+			return true;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		precompute(env);
+		float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+		std::cout << "IBL precomputed in " << seconds << " s" << std::endl;
+
+		if (!writeCache(cachePath, key))
+		{
+			std::cout << "Failed to write IBL cache: " << cachePath << std::endl;
+		}
+		return true;
+	}
+
+	void precompute(TextureRGB24& env)
+	{
+		// 环境图按sRGB存储，先转到线性空间再积分
+		Texture2D<Vec3> source;
+		source.init(env.width, env.height);
+		for (int j = 0; j < env.height; j++)
+		{
+			for (int i = 0; i < env.width; i++)
+			{
+				source(i, j) = pow(env(i, j).toVec3(), 2.2f);
+			}
+		}
+		source.generateMipmaps();
+
+		computeIrradiance(source);
+		computeSpecular(source);
+		computeBRDF();
+	}
+
+	// 漫反射部分，已除以Pi，乘以反照率即可
+	Vec3 irradiance(Vec3 N)
+	{
+		return sampleEquirect(irradianceMap, N);
+	}
+
+	// 反射方向R上按粗糙度取预滤波的环境光，相邻两级之间线性插值
+	Vec3 specular(Vec3 R, float roughness)
+	{
+		float lod = std::min(std::max(roughness, 0.0f), 1.0f) * (IBL_SPECULAR_LEVELS - 1);
+		int base = (int)lod;
+		int next = std::min(base + 1, IBL_SPECULAR_LEVELS - 1);
+
+		Vec3 c1 = sampleEquirect(specularMaps[base], R);
+		if (next == base) return c1;
+
+		Vec3 c2 = sampleEquirect(specularMaps[next], R);
+		return lerp(c1, c2, lod - base);
+	}
+
+	// 返回(scale, bias)，镜面部分为 specular(R) * (F0 * scale + bias)
+	Vec2 brdf(float NdotV, float roughness)
+	{
+		float x = std::min(std::max(NdotV, 0.0f), 1.0f) * IBL_BRDF_SIZE - 0.5f;
+		float y = std::min(std::max(roughness, 0.0f), 1.0f) * IBL_BRDF_SIZE - 0.5f;
+
+		x = std::min(std::max(x, 0.0f), IBL_BRDF_SIZE - 1.0f);
+		y = std::min(std::max(y, 0.0f), IBL_BRDF_SIZE - 1.0f);
+
+		int x0 = (int)x, y0 = (int)y;
+		int x1 = std::min(x0 + 1, IBL_BRDF_SIZE - 1), y1 = std::min(y0 + 1, IBL_BRDF_SIZE - 1);
+
+		Vec2 top = lerp(brdfLUT(x0, y0), brdfLUT(x1, y0), x - x0);
+		Vec2 bottom = lerp(brdfLUT(x0, y1), brdfLUT(x1, y1), x - x0);
+		return lerp(top, bottom, y - y0);
+	}
+
+	bool ready() { return brdfLUT.width > 0; }
+
+private:
+	template<typename T>
+	static Vec3 sampleEquirect(FrameBuffer<T>& map, Vec3 dir)
+	{
+		float u = std::atan2(dir[1], dir[0]) / (2.0f * Pi) + 0.5f;
+		float v = std::acos(std::min(std::max(dir[2], -1.0f), 1.0f)) / Pi;
+		return sampleEquirect(map, u, v);
+	}
+
+	// u方向环绕，v方向截断，以纹素中心为采样点
+	template<typename T>
+	static Vec3 sampleEquirect(FrameBuffer<T>& map, float u, float v)
+	{
+		float x = u * map.width - 0.5f;
+		float y = std::min(std::max(v * map.height - 0.5f, 0.0f), map.height - 1.0f);
+
+		int x0 = (int)std::floor(x), y0 = (int)y;
+		float fx = x - x0, fy = y - y0;
+
+		int x1 = x0 + 1, y1 = std::min(y0 + 1, map.height - 1);
+		x0 = (x0 % map.width + map.width) % map.width;
+		x1 = (x1 % map.width + map.width) % map.width;
+
+		Vec3 top = lerp(map(x0, y0), map(x1, y0), fx);
+		Vec3 bottom = lerp(map(x0, y1), map(x1, y1), fx);
+		return lerp(top, bottom, fy);
+	}
+
+	static Vec3 sampleSource(Texture2D<Vec3>& source, Vec3 dir, float lod)
+	{
+		lod = std::min(std::max(lod, 0.0f), (float)(source.levels - 1));
+		int base = (int)lod;
+		int next = std::min(base + 1, source.levels - 1);
+
+		Vec3 c1 = sampleEquirect(source.level(base), dir);
+		if (next == base) return c1;
+		return lerp(c1, sampleEquirect(source.level(next), dir), lod - base);
+	}
+
+	static Vec3 texelDirection(int i, int j, int width, int height)
+	{
+		float phi = ((i + 0.5f) / width - 0.5f) * 2.0f * Pi;
+		float theta = (j + 0.5f) / height * Pi;
+		return { std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta) };
+	}
+
+	static Vec2 hammersley(int i, int count)
+	{
+		uint32_t bits = i;
+		bits = (bits << 16) | (bits >> 16);
+		bits = ((bits & 0x55555555u) << 1) | ((bits & 0xAAAAAAAAu) >> 1);
+		bits = ((bits & 0x33333333u) << 2) | ((bits & 0xCCCCCCCCu) >> 2);
+		bits = ((bits & 0x0F0F0F0Fu) << 4) | ((bits & 0xF0F0F0F0u) >> 4);
+		bits = ((bits & 0x00FF00FFu) << 8) | ((bits & 0xFF00FF00u) >> 8);
+		return { (float)i / count, bits * 2.3283064365386963e-10f };
+	}
+
+	// 按GGX分布重要性采样半角向量，返回以N为z轴的世界空间方向
+	static Vec3 importanceSampleGGX(Vec2 xi, Vec3 N, float roughness)
+	{
+		float a = roughness * roughness;
+
+		float phi = 2.0f * Pi * xi[0];
+		float cosTheta = std::sqrt((1.0f - xi[1]) / (1.0f + (a * a - 1.0f) * xi[1]));
+		float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+
+		Vec3 up = std::abs(N[2]) < 0.999f ? Vec3{ 0.0f, 0.0f, 1.0f } : Vec3{ 1.0f, 0.0f, 0.0f };
+		Vec3 tangent = cross(up, N).normalized();
+		Vec3 bitangent = cross(N, tangent);
+
+		return (tangent * (std::cos(phi) * sinTheta) + bitangent * (std::sin(phi) * sinTheta) + N * cosTheta).normalized();
+	}
+
+	// 行按原子计数分给各线程，每行的结果与线程数无关
+	template<typename Func>
+	static void parallelRows(int rows, Func func)
+	{
+		std::atomic<int> next{ 0 };
+		int threadCount = std::max(1, (int)std::thread::hardware_concurrency());
+
+		std::vector<std::thread> threads;
+		for (int t = 0; t < threadCount; t++)
+		{
+			threads.emplace_back([&]()
+			{
+				int row;
+				while ((row = next++) < rows) func(row);
+			});
+		}
+
+		for (auto& thread : threads) thread.join();
+	}
+
+	// 对源图每个纹素按立体角加权求余弦卷积
+	void computeIrradiance(Texture2D<Vec3>& source)
+	{
+		int level = 0;
+		while (level < source.levels - 1 && source.level(level).width > IBL_IRRADIANCE_SOURCE_WIDTH) level++;
+		FrameBuffer<Vec3>& src = source.level(level);
+
+		std::vector<Vec3> directions(src.width * src.height);
+		std::vector<Vec3> radiance(src.width * src.height);
+
+		for (int j = 0; j < src.height; j++)
+		{
+			float theta = (j + 0.5f) / src.height * Pi;
+			float solidAngle = (2.0f * Pi / src.width) * (Pi / src.height) * std::sin(theta);
+
+			for (int i = 0; i < src.width; i++)
+			{
+				directions[j * src.width + i] = texelDirection(i, j, src.width, src.height);
+				radiance[j * src.width + i] = src(i, j) * solidAngle;
+			}
+		}
+
+		irradianceMap.release();
+		irradianceMap.init(IBL_IRRADIANCE_WIDTH, IBL_IRRADIANCE_HEIGHT);
+
+		parallelRows(IBL_IRRADIANCE_HEIGHT, [&](int j)
+		{
+			for (int i = 0; i < IBL_IRRADIANCE_WIDTH; i++)
+			{
+				Vec3 N = texelDirection(i, j, IBL_IRRADIANCE_WIDTH, IBL_IRRADIANCE_HEIGHT);
+				Vec3 sum(0.0f);
+
+				for (int k = 0; k < directions.size(); k++)
+				{
+					float cosine = dot(N, directions[k]);
+					if (cosine > 0.0f) sum += radiance[k] * cosine;
+				}
+
+				irradianceMap(i, j) = sum / Pi;
+			}
+		});
+	}
+
+	// 每级对应一个粗糙度，按N=V=R的近似做GGX重要性采样；
+	// 采样点按概率密度选源图的mip级别，少量样本即可避免亮点
+	void computeSpecular(Texture2D<Vec3>& source)
+	{
+		int width = std::min(source.width, IBL_SPECULAR_WIDTH);
+		int height = std::min(source.height, IBL_SPECULAR_HEIGHT);
+		float texelSolidAngle = 4.0f * Pi / (source.width * source.height);
+		// 镜面级按输出分辨率取源图，源图比输出大时不产生走样
+		float baseLod = std::log2((float)source.width / width);
+
+		for (int l = 0; l < IBL_SPECULAR_LEVELS; l++)
+		{
+			FrameBuffer<Vec3>& map = specularMaps[l];
+			map.release();
+			map.init(std::max(width >> l, 1), std::max(height >> l, 1));
+
+			float roughness = (float)l / (IBL_SPECULAR_LEVELS - 1);
+
+			parallelRows(map.height, [&](int j)
+			{
+				for (int i = 0; i < map.width; i++)
+				{
+					Vec3 N = texelDirection(i, j, map.width, map.height);
+
+					if (l == 0)
+					{
+						map(i, j) = sampleSource(source, N, baseLod);
+						continue;
+					}
+
+					Vec3 sum(0.0f);
+					float weight = 0.0f;
+
+					for (int k = 0; k < IBL_SPECULAR_SAMPLES; k++)
+					{
+						Vec3 H = importanceSampleGGX(hammersley(k, IBL_SPECULAR_SAMPLES), N, roughness);
+						Vec3 L = H * (2.0f * dot(N, H)) - N;
+
+						float NdotL = dot(N, L);
+						if (NdotL <= 0.0f) continue;
+
+						// N=V时pdf = D * NdotH / (4 * VdotH) = D / 4
+						float NdotH = std::max(dot(N, H), 0.0f);
+						float a2 = roughness * roughness * roughness * roughness;
+						float denom = NdotH * NdotH * (a2 - 1.0f) + 1.0f;
+						float pdf = a2 / (Pi * denom * denom) / 4.0f + 0.0001f;
+
+						float sampleSolidAngle = 1.0f / (IBL_SPECULAR_SAMPLES * pdf);
+						float lod = 0.5f * std::log2(sampleSolidAngle / texelSolidAngle) + 1.0f;
+
+						sum += sampleSource(source, L, lod) * NdotL;
+						weight += NdotL;
+					}
+
+					map(i, j) = sum / std::max(weight, 0.0001f);
+				}
+			});
+		}
+	}
+
+	// x为NdotV，y为粗糙度；几何项用IBL的k = a / 2
+	void computeBRDF()
+	{
+		brdfLUT.release();
+		brdfLUT.init(IBL_BRDF_SIZE, IBL_BRDF_SIZE);
+
+		parallelRows(IBL_BRDF_SIZE, [&](int j)
+		{
+			float roughness = (j + 0.5f) / IBL_BRDF_SIZE;
+			float k = roughness * roughness / 2.0f;
+
+			for (int i = 0; i < IBL_BRDF_SIZE; i++)
+			{
+				float NdotV = (i + 0.5f) / IBL_BRDF_SIZE;
+				Vec3 V = { std::sqrt(1.0f - NdotV * NdotV), 0.0f, NdotV };
+				Vec3 N = { 0.0f, 0.0f, 1.0f };
+
+				float scale = 0.0f, bias = 0.0f;
+
+				for (int s = 0; s < IBL_BRDF_SAMPLES; s++)
+				{
+					Vec3 H = importanceSampleGGX(hammersley(s, IBL_BRDF_SAMPLES), N, roughness);
+					Vec3 L = H * (2.0f * dot(V, H)) - V;
+
+					float NdotL = std::max(L[2], 0.0f);
+					float NdotH = std::max(H[2], 0.0f);
+					float VdotH = std::max(dot(V, H), 0.0f);
+					if (NdotL <= 0.0f) continue;
+
+					float G = (NdotV / (NdotV * (1.0f - k) + k)) * (NdotL / (NdotL * (1.0f - k) + k));
+					float visibility = G * VdotH / (NdotH * NdotV);
+					float Fc = std::pow(1.0f - VdotH, 5.0f);
+
+					scale += (1.0f - Fc) * visibility;
+					bias += Fc * visibility;
+				}
+
+				brdfLUT(i, j) = { scale / IBL_BRDF_SAMPLES, bias / IBL_BRDF_SAMPLES };
+			}
+		});
+	}
+
+	// FNV-1a，覆盖环境图的尺寸、像素与预计算参数
+	static uint64_t hashEnvironment(TextureRGB24& env)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		auto feed = [&](const void *data, size_t size)
+		{
+			const BYTE *bytes = (const BYTE*)data;
+			for (size_t i = 0; i < size; i++) hash = (hash ^ bytes[i]) * 1099511628211ull;
+		};
+
+		int params[] =
+		{
+			(int)IBL_CACHE_VERSION, env.width, env.height,
+			IBL_IRRADIANCE_WIDTH, IBL_IRRADIANCE_HEIGHT, IBL_IRRADIANCE_SOURCE_WIDTH,
+			IBL_SPECULAR_WIDTH, IBL_SPECULAR_HEIGHT, IBL_SPECULAR_LEVELS, IBL_SPECULAR_SAMPLES,
+			IBL_BRDF_SIZE, IBL_BRDF_SAMPLES
+		};
+		feed(params, sizeof(params));
+		feed(env.ptr(), env.width * env.height * sizeof(RGB24));
+		return hash;
+	}
+
+	// 文件格式：魔数、版本、键，之后依次为各张表的宽、高与数据
+	bool readCache(const std::string& path, uint64_t key)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file) return false;
+
+		char magic[4];
+		uint32_t version;
+		uint64_t fileKey;
+		file.read(magic, 4);
+		file.read((char*)&version, sizeof(version));
+		file.read((char*)&fileKey, sizeof(fileKey));
+
+		if (!file || memcmp(magic, "IBL\0", 4) != 0 || version != IBL_CACHE_VERSION || fileKey != key) return false;
+
+		bool ok = readMap(file, irradianceMap);
+		for (int l = 0; l < IBL_SPECULAR_LEVELS && ok; l++) ok = readMap(file, specularMaps[l]);
+		ok = ok && readMap(file, brdfLUT);
+
+		if (!ok) brdfLUT.release();
+		return ok;
+	}
+
+	bool writeCache(const std::string& path, uint64_t key)
+	{
+		std::ofstream file(path, std::ios::binary);
+		if (!file) return false;
+
+		uint32_t version = IBL_CACHE_VERSION;
+		file.write("IBL\0", 4);
+		file.write((char*)&version, sizeof(version));
+		file.write((char*)&key, sizeof(key));
+
+		writeMap(file, irradianceMap);
+		for (int l = 0; l < IBL_SPECULAR_LEVELS; l++) writeMap(file, specularMaps[l]);
+		writeMap(file, brdfLUT);
+
+		return (bool)file;
+	}
+
+	template<typename T>
+	static bool readMap(std::ifstream& file, FrameBuffer<T>& map)
+	{
+		int size[2];
+		file.read((char*)size, sizeof(size));
+		if (!file || size[0] <= 0 || size[1] <= 0 || size[0] > 4096 || size[1] > 4096) return false;
+
+		map.release();
+		map.init(size[0], size[1]);
+		file.read((char*)map.ptr(), map.width * map.height * sizeof(T));
+		return (bool)file;
+	}
+
+	template<typename T>
+	static void writeMap(std::ofstream& file, FrameBuffer<T>& map)
+	{
+		int size[2] = { map.width, map.height };
+		file.write((char*)size, sizeof(size));
+		file.write((char*)map.ptr(), map.width * map.height * sizeof(T));
+	}
+
+	FrameBuffer<Vec3> irradianceMap;
+	FrameBuffer<Vec3> specularMaps[IBL_SPECULAR_LEVELS];
+	FrameBuffer<Vec2> brdfLUT;
+};
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef IMAGEWRITER_H
+#define IMAGEWRITER_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+
+#include "stb_image/stb_image_write.h"
+#include "Color.h"
+#include "FrameBuffer.h"
+
+enum
+{
+	IMAGE_PPM = 0,
+	IMAGE_PNG,
+	IMAGE_RAW
+} ImageFormat;
+
+namespace ImageWriter
+{
+	inline int formatFromPath(const std::string& path)
+	{
+		size_t dot = path.find_last_of('.');
+		if (dot == std::string::npos) return IMAGE_RAW;
+
+		std::string ext = path.substr(dot + 1);
+		if (ext == "png" || ext == "PNG") return IMAGE_PNG;
+		if (ext == "ppm" || ext == "PPM") return IMAGE_PPM;
+		return IMAGE_RAW;
+	}
+
+	inline void writeToStream(void *context, void *data, int size)
+	{
+		((std::ostream*)context)->write((const char*)data, size);
+	}
+
+	// 缓冲第0行即图像顶行，三种格式都可以直接按行顺序写出
+	inline bool write(std::ostream& out, FrameBuffer<RGB24>& buf, int format)
+	{
+		int byteSize = buf.width * buf.height * sizeof(RGB24);
+
+		switch (format)
+		{
+			case IMAGE_PPM:
+				out << "P6\n" << buf.width << " " << buf.height << "\n255\n";
+				out.write((const char*)buf.bufPtr(), byteSize);
+				break;
+			case IMAGE_PNG:
+				if (!stbi_write_png_to_func(writeToStream, &out, buf.width, buf.height, 3, buf.bufPtr(), buf.width * sizeof(RGB24)))
+				{
+					return false;
+				}
+				break;
+			case IMAGE_RAW:
+			default:
+				out.write((const char*)buf.bufPtr(), byteSize);
+				break;
+		}
+
+		return out.good();
+	}
+
+	inline bool write(const std::string& path, FrameBuffer<RGB24>& buf, int format)
+	{
+		std::ofstream file(path, std::ios::binary);
+
+		if (!file.is_open())
+		{
+			std::cout << "Error writing image: " << path << std::endl;
+			return false;
+		}
+
+		return write(file, buf, format);
+	}
+}
+
+#endif
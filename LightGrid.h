@@ -0,0 +1,191 @@
+#ifndef LIGHTGRID_H
+#define LIGHTGRID_H
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+#include "math/Vector.h"
+#include "math/Matrix.h"
+#include "FrameBufferAdapter.h"
+
+const int LIGHT_TILE_SIZE = 16;
+
+// 点光源，color已乘上强度；radius以外不贡献光照，用于剔除
+struct PointLight
+{
+	Vec3 pos;
+	Vec3 color;
+	float radius;
+};
+
+// Forward+的光源剔除：屏幕按LIGHT_TILE_SIZE分块，每块从深度缓冲取深度范围，
+// 光源包围球投影到屏幕的矩形与深度范围都与某块相交时才记入该块的列表
+// 片元着色时只遍历所在块的光源
+class LightGrid
+{
+public:
+	// 需在深度已写好之后（如深度预pass之后）调用，与draw同序时应经由Renderer::submit
+	void cull(const std::vector<PointLight>& lights, Mat4 view, Mat4 proj, FrameBufferAdapter& adapter)
+	{
+		this->lights = lights;
+
+		if (adapter.depthAttachment == nullptr) return;
+
+		width = adapter.depthAttachment->width();
+		height = adapter.depthAttachment->height();
+		tilesX = (width + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE;
+		tilesY = (height + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE;
+
+		computeDepthRanges(adapter);
+
+		int tileCount = tilesX * tilesY;
+		offsets.assign(tileCount + 1, 0);
+		indices.clear();
+
+		// 先统计每块的光源数，再按前缀和填入，列表连续存放
+		std::vector<int> rects(lights.size() * 4);
+		std::vector<float> depths(lights.size() * 2);
+
+		for (int i = 0; i < lights.size(); i++)
+		{
+			if (!project(this->lights[i], view, proj, &rects[i * 4], &depths[i * 2]))
+			{
+				// 空矩形，不覆盖任何块
+				rects[i * 4 + 0] = 1, rects[i * 4 + 2] = 0;
+				rects[i * 4 + 1] = rects[i * 4 + 3] = 0;
+			}
+			forEachTile(&rects[i * 4], &depths[i * 2], [&](int tile) { offsets[tile + 1]++; });
+		}
+
+		for (int i = 0; i < tileCount; i++) offsets[i + 1] += offsets[i];
+
+		indices.resize(offsets[tileCount]);
+		std::vector<int> cursor(offsets.begin(), offsets.end() - 1);
+
+		for (int i = 0; i < lights.size(); i++)
+		{
+			forEachTile(&rects[i * 4], &depths[i * 2], [&](int tile) { indices[cursor[tile]++] = i; });
+		}
+	}
+
+	// 返回像素(x, y)所在块的光源下标
+	const int* tileLights(int x, int y, int& count) const
+	{
+		count = 0;
+		if (x < 0 || x >= width || y < 0 || y >= height) return nullptr;
+
+		int tile = (y / LIGHT_TILE_SIZE) * tilesX + x / LIGHT_TILE_SIZE;
+		count = offsets[tile + 1] - offsets[tile];
+		return indices.data() + offsets[tile];
+	}
+
+	std::vector<PointLight> lights;
+
+private:
+	// 每块中被覆盖像素的最小、最大深度，没有被覆盖的块范围为空
+	void computeDepthRanges(FrameBufferAdapter& adapter)
+	{
+		minDepth.assign(tilesX * tilesY, 1e30f);
+		maxDepth.assign(tilesX * tilesY, -1e30f);
+
+		FrameBufferAdapter local = adapter;
+
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				local.x = x, local.y = y;
+				if (!local.covered()) continue;
+
+				float depth = local.readDepth();
+				int tile = (y / LIGHT_TILE_SIZE) * tilesX + x / LIGHT_TILE_SIZE;
+
+				minDepth[tile] = std::min(minDepth[tile], depth);
+				maxDepth[tile] = std::max(maxDepth[tile], depth);
+			}
+		}
+	}
+
+	// 包围球在观察空间的包围盒8个角投影到屏幕取矩形，球心前后两点投影得深度范围
+	// 球与近平面相交时退化为全屏；完全在相机后方时返回false
+	bool project(PointLight& light, Mat4& view, Mat4& proj, int rect[4], float depth[2])
+	{
+		Vec4 pos = { light.pos[0], light.pos[1], light.pos[2], 1.0f };
+		Vec4 center = view * pos;
+		float r = light.radius;
+
+		float nearDist = -center[2] - r, farDist = -center[2] + r;
+		float zNear = proj(2, 3) / proj(2, 2);
+
+		if (farDist <= zNear) return false;
+
+		depth[0] = (nearDist <= zNear) ? -1e30f : ndcDepth(proj, nearDist);
+		depth[1] = ndcDepth(proj, farDist);
+
+		if (nearDist <= zNear)
+		{
+			rect[0] = 0, rect[1] = 0, rect[2] = tilesX - 1, rect[3] = tilesY - 1;
+			return true;
+		}
+
+		float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f;
+
+		for (int i = 0; i < 8; i++)
+		{
+			Vec4 corner =
+			{
+				center[0] + ((i & 1) ? r : -r),
+				center[1] + ((i & 2) ? r : -r),
+				center[2] + ((i & 4) ? r : -r),
+				1.0f
+			};
+			Vec4 clip = proj * corner;
+
+			float x = (clip[0] / clip[3] + 1.0f) / 2.0f * width;
+			float y = (clip[1] / clip[3] + 1.0f) / 2.0f * height;
+
+			minX = std::min(minX, x), maxX = std::max(maxX, x);
+			minY = std::min(minY, y), maxY = std::max(maxY, y);
+		}
+
+		rect[0] = std::max((int)std::floor(minX) / LIGHT_TILE_SIZE, 0);
+		rect[1] = std::max((int)std::floor(minY) / LIGHT_TILE_SIZE, 0);
+		rect[2] = std::min((int)std::floor(maxX) / LIGHT_TILE_SIZE, tilesX - 1);
+		rect[3] = std::min((int)std::floor(maxY) / LIGHT_TILE_SIZE, tilesY - 1);
+
+		return true;
+	}
+
+	static float ndcDepth(Mat4& proj, float dist)
+	{
+		return (proj(2, 2) * -dist + proj(2, 3)) / dist;
+	}
+
+	template<typename Func>
+	void forEachTile(int rect[4], float depth[2], Func func)
+	{
+		for (int ty = rect[1]; ty <= rect[3]; ty++)
+		{
+			for (int tx = rect[0]; tx <= rect[2]; tx++)
+			{
+				int tile = ty * tilesX + tx;
+				if (depth[0] > maxDepth[tile] || depth[1] < minDepth[tile]) continue;
+
+				func(tile);
+			}
+		}
+	}
+
+	int width = 0;
+	int height = 0;
+	int tilesX = 0;
+	int tilesY = 0;
+
+	std::vector<float> minDepth;
+	std::vector<float> maxDepth;
+	std::vector<int> offsets;
+	std::vector<int> indices;
+};
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+
+#include "Platform.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// 只读的内存映射文件，内容由系统按页读入，不经过流的缓冲与拷贝
+class MappedFile
+{
+public:
+	MappedFile() {}
+
+	~MappedFile()
+	{
+		close();
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator = (const MappedFile&) = delete;
+
+	bool open(const char *filePath)
+	{
+		close();
+
+#ifdef _WIN32
+		file = CreateFileA(filePath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize))
+		{
+			close();
+			return false;
+		}
+		length = (size_t)fileSize.QuadPart;
+		if (length == 0) return true;
+
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr)
+		{
+			close();
+			return false;
+		}
+
+		bytes = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+		fd = ::open(filePath, O_RDONLY);
+		if (fd < 0) return false;
+
+		struct stat st;
+		if (fstat(fd, &st) != 0)
+		{
+			close();
+			return false;
+		}
+		length = (size_t)st.st_size;
+		if (length == 0) return true;
+
+		void *ptr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		bytes = (ptr == MAP_FAILED) ? nullptr : (const char*)ptr;
+
+		// 整个文件会顺序读一遍，提示内核提前预读
+		if (bytes != nullptr) madvise(ptr, length, MADV_SEQUENTIAL);
+#endif
+
+		if (bytes == nullptr)
+		{
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close()
+	{
+#ifdef _WIN32
+		if (bytes != nullptr) UnmapViewOfFile(bytes);
+		if (mapping != nullptr) CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+		mapping = nullptr;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (bytes != nullptr) munmap((void*)bytes, length);
+		if (fd >= 0) ::close(fd);
+		fd = -1;
+#endif
+		bytes = nullptr;
+		length = 0;
+	}
+
+	const char* data() { return bytes; }
+	size_t size() { return length; }
+
+private:
+	const char *bytes = nullptr;
+	size_t length = 0;
+
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#else
+	int fd = -1;
+#endif
+};
+
+#endif
@@ -0,0 +1,528 @@
+#ifndef MESHFILE_H
+#define MESHFILE_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <sys/stat.h>
+
+#include "Platform.h"
+#include "ArrayView.h"
+#include "VertexLayout.h"
+#include "MappedFile.h"
+#include "ObjReader.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "Camera.h"
+
+const uint32_t MESH_FILE_VERSION = 5;
+// ObjReader输出的每个顶点依次为位置(3)、纹理坐标(2)、法线(3)
+const uint32_t MESH_VERTEX_FLOATS = 8;
+// 量化布局：位置与纹理坐标为按包围盒反量化的16位定点，法线为八面体编码，末尾2字节填充
+const uint32_t MESH_QUANTIZED_STRIDE = 16;
+const int MESH_MAX_ATTRIBUTES = 4;
+// LOD链：每级目标三角形数减半，简化不动、少于最小三角形数或误差超过包围球半径的一定比例时停止
+const int MESH_MAX_LODS = 8;
+const size_t MESH_LOD_MIN_TRIANGLES = 64;
+const float MESH_LOD_MIN_REDUCTION = 0.8f;
+const float MESH_LOD_MAX_RELATIVE_ERROR = 0.25f;
+// 选LOD时允许的屏幕空间误差（像素）
+const float MESH_LOD_PIXEL_ERROR = 1.0f;
+// 顶点块与索引块的起始位置按缓存行对齐，映射后可直接当作数组使用
+const uint64_t MESH_BLOCK_ALIGNMENT = 64;
+
+enum
+{
+	MESH_ATTRIBUTE_POSITION = 0,
+	MESH_ATTRIBUTE_TEXCOORD,
+	MESH_ATTRIBUTE_NORMAL
+} MeshAttributeSemantic;
+
+// 顶点块中一个属性的格式与在顶点内的字节偏移，scale与bias为VERTEX_UNORM16的反量化参数
+struct MeshAttributeDesc
+{
+	uint32_t semantic;
+	uint32_t format;
+	uint32_t components;
+	uint32_t offset;
+	float scale[4];
+	float bias[4];
+};
+
+// 一级LOD在索引块中的范围与相对原网格的几何误差（模型空间距离），各级共用同一份顶点
+struct MeshLodDesc
+{
+	uint32_t indexOffset;
+	uint32_t indexCount;
+	float error;
+	uint32_t reserved;
+};
+
+// 二进制网格文件头，其后为对齐的顶点块与UINT索引块，顶点按attributes描述的布局交错存放
+// 索引块依次存放各级LOD，第0级为原网格
+struct MeshFileHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t vertexStride;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t attributeCount;
+	MeshAttributeDesc attributes[MESH_MAX_ATTRIBUTES];
+	uint32_t lodCount;
+	MeshLodDesc lods[MESH_MAX_LODS];
+	// 模型空间的包围球，选LOD时估计到相机的距离
+	float center[3];
+	float radius;
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	// 源OBJ的大小与修改时间，任一不一致即重新生成
+	uint64_t sourceSize;
+	int64_t sourceTime;
+};
+
+// 带二进制缓存的网格：第一次从OBJ解析、合并相同顶点并优化三角形与顶点顺序后写入<obj>.mesh，
+// 之后的启动直接映射缓存文件，vertices按文件头中的布局读取映射的内存，不做任何解析与拷贝
+// quantize时改用16字节的量化布局写入<obj>.q.mesh，顶点内存与带宽减半，取顶点时解码
+// 同时用QEM简化生成LOD链，indices为第0级，lodIndices(selectLod(...))按屏幕空间误差取合适的一级
+// Vertex需要有pos、texCoord、norm三个成员
+template<typename Vertex>
+class Mesh
+{
+public:
+	bool load(const char *objPath, bool quantize = false)
+	{
+		std::string cachePath = std::string(objPath) + (quantize ? ".q.mesh" : ".mesh");
+
+		uint64_t sourceSize;
+		int64_t sourceTime;
+		if (!sourceInfo(objPath, sourceSize, sourceTime))
+		{
+			std::cout << "Error loading Obj: " << objPath << std::endl;
+			return false;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+
+		if (map(cachePath, sourceSize, sourceTime))
+		{
+			float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+			std::cout << "Mapped mesh cache: " << cachePath << " (" << vertices.size() << " vertices, "
+				<< indices.size() / 3 << " triangles, " << layout.lodCount << " LODs, " << layout.vertexStride << " bytes/vertex) in "
+				<< seconds << " s" << std::endl;
+			return true;
+		}
+
+		ObjReader objReader;
+		std::vector<float> data = objReader.readFile(objPath);
+		if (data.empty()) return false;
+
+		weld(data);
+		optimize(data);
+		if (quantize) pack(data);
+		else store(data);
+		buildLods(data);
+
+		if (write(cachePath, sourceSize, sourceTime) && map(cachePath, sourceSize, sourceTime))
+		{
+			// 之后都用映射的数据，解析结果不再需要
+			std::vector<BYTE>().swap(ownedVertices);
+			std::vector<UINT>().swap(ownedIndices);
+			std::cout << "Wrote mesh cache: " << cachePath << std::endl;
+			return true;
+		}
+
+		// 缓存不可写时直接使用内存中的结果
+		std::cout << "Failed to write mesh cache: " << cachePath << std::endl;
+
+		bindVertices(layout, ownedVertices.data());
+		bindIndices(ownedIndices.data());
+		return true;
+	}
+
+	int lodCount() { return layout.lodCount; }
+
+	// 没有载入成功时lodCount为0，返回空数组
+	ArrayView<UINT> lodIndices(int level)
+	{
+		if (layout.lodCount == 0) return ArrayView<UINT>();
+
+		MeshLodDesc& lod = layout.lods[std::min(std::max(level, 0), (int)layout.lodCount - 1)];
+		return ArrayView<UINT>(indexData + lod.indexOffset, lod.indexCount);
+	}
+
+	// 模型空间的包围球
+	Vec3 boundingCenter() { return { layout.center[0], layout.center[1], layout.center[2] }; }
+	float boundingRadius() { return layout.radius; }
+
+	// 包围球最近处一个单位长度投影到屏幕上的像素数乘以各级误差，取误差不超过pixelError的最粗一级
+	int selectLod(Camera& camera, Mat4& model, int viewportHeight, float pixelError = MESH_LOD_PIXEL_ERROR)
+	{
+		if (layout.lodCount <= 1) return 0;
+
+		Vec4 center = { layout.center[0], layout.center[1], layout.center[2], 1.0f };
+		Vec4 worldCenter = model * center;
+
+		float scale = 0.0f;
+		for (int j = 0; j < 3; j++)
+		{
+			scale = std::max(scale, std::sqrt(model(0, j) * model(0, j) + model(1, j) * model(1, j) + model(2, j) * model(2, j)));
+		}
+
+		Vec3 offset = Vec3{ worldCenter[0], worldCenter[1], worldCenter[2] } - camera.pos();
+		float distance = std::max(length(offset) - layout.radius * scale, camera.nearPlane());
+		float pixelsPerUnit = viewportHeight / (2.0f * std::tan(toRad(camera.FOV()) / 2.0f) * distance);
+
+		for (int level = layout.lodCount - 1; level > 0; level--)
+		{
+			if (layout.lods[level].error * scale * pixelsPerUnit <= pixelError) return level;
+		}
+		return 0;
+	}
+
+	VertexView<Vertex> vertices;
+	ArrayView<UINT> indices;
+
+private:
+	static bool sourceInfo(const char *path, uint64_t& size, int64_t& time)
+	{
+		struct stat st;
+		if (stat(path, &st) != 0) return false;
+
+		size = (uint64_t)st.st_size;
+		time = (int64_t)st.st_mtime;
+		return true;
+	}
+
+	static uint64_t alignUp(uint64_t value)
+	{
+		return (value + MESH_BLOCK_ALIGNMENT - 1) / MESH_BLOCK_ALIGNMENT * MESH_BLOCK_ALIGNMENT;
+	}
+
+	bool map(const std::string& path, uint64_t sourceSize, int64_t sourceTime)
+	{
+		if (!file.open(path.c_str())) return false;
+
+		MeshFileHeader *header = (MeshFileHeader*)file.data();
+		uint64_t size = file.size();
+
+		bool valid = size >= sizeof(MeshFileHeader) &&
+			memcmp(header->magic, "SRMH", 4) == 0 &&
+			header->version == MESH_FILE_VERSION &&
+			header->attributeCount <= MESH_MAX_ATTRIBUTES &&
+			header->sourceSize == sourceSize &&
+			header->sourceTime == sourceTime &&
+			header->vertexOffset % MESH_BLOCK_ALIGNMENT == 0 &&
+			header->indexOffset % MESH_BLOCK_ALIGNMENT == 0 &&
+			header->vertexOffset + (uint64_t)header->vertexCount * header->vertexStride <= size &&
+			header->indexOffset + (uint64_t)header->indexCount * sizeof(UINT) <= size &&
+			header->lodCount >= 1 && header->lodCount <= MESH_MAX_LODS;
+
+		for (uint32_t i = 0; valid && i < header->lodCount; i++)
+		{
+			valid = (uint64_t)header->lods[i].indexOffset + header->lods[i].indexCount <= header->indexCount;
+		}
+
+		// 每个属性的格式必须与接收它的成员匹配，且落在一个顶点之内
+		for (uint32_t i = 0; valid && i < header->attributeCount; i++)
+		{
+			MeshAttributeDesc& desc = header->attributes[i];
+			uint32_t components = (desc.semantic == MESH_ATTRIBUTE_TEXCOORD) ? 2 : 3;
+			uint32_t bytes = 0;
+			if (desc.format == VERTEX_FLOAT) bytes = components * sizeof(float);
+			else if (desc.format == VERTEX_UNORM16) bytes = components * sizeof(uint16_t);
+			else if (desc.format == VERTEX_OCT16 && desc.semantic == MESH_ATTRIBUTE_NORMAL) bytes = 2 * sizeof(int16_t);
+
+			valid = desc.semantic <= MESH_ATTRIBUTE_NORMAL && desc.components == components && bytes > 0 &&
+				desc.offset + bytes <= header->vertexStride;
+		}
+
+		if (!valid)
+		{
+			file.close();
+			return false;
+		}
+
+		layout = *header;
+		bindVertices(layout, (const BYTE*)file.data() + header->vertexOffset);
+		bindIndices((UINT*)(file.data() + header->indexOffset));
+		return true;
+	}
+
+	void bindIndices(UINT *data)
+	{
+		indexData = data;
+		indices = lodIndices(0);
+	}
+
+	void bindVertices(MeshFileHeader& header, const BYTE *data)
+	{
+		vertices = VertexView<Vertex>(header.vertexCount);
+
+		for (uint32_t i = 0; i < header.attributeCount; i++)
+		{
+			MeshAttributeDesc& desc = header.attributes[i];
+
+			switch (desc.semantic)
+			{
+				case MESH_ATTRIBUTE_POSITION:
+					vertices.bind(&Vertex::pos, data, desc.offset, header.vertexStride, desc.format, desc.scale, desc.bias);
+					break;
+				case MESH_ATTRIBUTE_TEXCOORD:
+					vertices.bind(&Vertex::texCoord, data, desc.offset, header.vertexStride, desc.format, desc.scale, desc.bias);
+					break;
+				case MESH_ATTRIBUTE_NORMAL:
+					vertices.bind(&Vertex::norm, data, desc.offset, header.vertexStride, desc.format, desc.scale, desc.bias);
+					break;
+			}
+		}
+	}
+
+	static MeshAttributeDesc attributeDesc(uint32_t semantic, uint32_t format, uint32_t components, uint32_t offset)
+	{
+		MeshAttributeDesc desc = { semantic, format, components, offset, { 1.0f, 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 0.0f, 0.0f } };
+		return desc;
+	}
+
+	MeshFileHeader makeHeader(uint64_t sourceSize, int64_t sourceTime)
+	{
+		MeshFileHeader header = layout;
+		memcpy(header.magic, "SRMH", 4);
+		header.version = MESH_FILE_VERSION;
+		header.indexCount = (uint32_t)ownedIndices.size();
+		header.vertexOffset = alignUp(sizeof(MeshFileHeader));
+		header.indexOffset = alignUp(header.vertexOffset + (uint64_t)header.vertexCount * header.vertexStride);
+		header.sourceSize = sourceSize;
+		header.sourceTime = sourceTime;
+		return header;
+	}
+
+	// 位置、纹理坐标、法线逐位相同的顶点合并为一个，data中留下合并后的顶点
+	void weld(std::vector<float>& data)
+	{
+		struct Key
+		{
+			float *v;
+			bool operator == (const Key& other) const { return memcmp(v, other.v, MESH_VERTEX_FLOATS * sizeof(float)) == 0; }
+		};
+		struct KeyHash
+		{
+			size_t operator () (const Key& key) const
+			{
+				uint64_t hash = 14695981039346656037ull;
+				const BYTE *bytes = (const BYTE*)key.v;
+				for (size_t i = 0; i < MESH_VERTEX_FLOATS * sizeof(float); i++) hash = (hash ^ bytes[i]) * 1099511628211ull;
+				return (size_t)hash;
+			}
+		};
+
+		size_t count = data.size() / MESH_VERTEX_FLOATS;
+		std::unordered_map<Key, UINT, KeyHash> unique;
+		unique.reserve(count);
+
+		std::vector<float> welded;
+		ownedIndices.resize(count);
+
+		for (size_t i = 0; i < count; i++)
+		{
+			float *v = &data[i * MESH_VERTEX_FLOATS];
+			auto result = unique.emplace(Key{ v }, (UINT)(welded.size() / MESH_VERTEX_FLOATS));
+			if (result.second) welded.insert(welded.end(), v, v + MESH_VERTEX_FLOATS);
+			ownedIndices[i] = result.first->second;
+		}
+		data.swap(welded);
+	}
+
+	// 重排三角形与顶点，写入缓存前做一次，之后映射的网格都是优化过的顺序
+	void optimize(std::vector<float>& data)
+	{
+		auto start = std::chrono::steady_clock::now();
+		size_t count = data.size() / MESH_VERTEX_FLOATS;
+
+		float acmrBefore = MeshOptimizer::analyzeVertexCache(ownedIndices);
+		float overdrawBefore = MeshOptimizer::analyzeOverdraw(ownedIndices, data.data(), count, MESH_VERTEX_FLOATS);
+
+		MeshOptimizer::optimizeVertexCache(ownedIndices, count);
+		MeshOptimizer::optimizeOverdraw(ownedIndices, data.data(), count, MESH_VERTEX_FLOATS);
+		MeshOptimizer::optimizeVertexFetch(ownedIndices, data, MESH_VERTEX_FLOATS);
+		count = data.size() / MESH_VERTEX_FLOATS;
+
+		float acmrAfter = MeshOptimizer::analyzeVertexCache(ownedIndices);
+		float overdrawAfter = MeshOptimizer::analyzeOverdraw(ownedIndices, data.data(), count, MESH_VERTEX_FLOATS);
+
+		float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+		std::cout << "Optimized mesh: ACMR " << acmrBefore << " -> " << acmrAfter
+			<< ", overdraw " << overdrawBefore << " -> " << overdrawAfter << " in " << seconds << " s" << std::endl;
+	}
+
+	// 浮点布局：位置、纹理坐标、法线依次交错
+	void store(std::vector<float>& data)
+	{
+		ownedVertices.assign((BYTE*)data.data(), (BYTE*)(data.data() + data.size()));
+
+		memset(&layout, 0, sizeof(layout));
+		layout.vertexStride = MESH_VERTEX_FLOATS * sizeof(float);
+		layout.vertexCount = (uint32_t)(data.size() / MESH_VERTEX_FLOATS);
+		layout.attributeCount = 3;
+		layout.attributes[0] = attributeDesc(MESH_ATTRIBUTE_POSITION, VERTEX_FLOAT, 3, 0);
+		layout.attributes[1] = attributeDesc(MESH_ATTRIBUTE_TEXCOORD, VERTEX_FLOAT, 2, 3 * sizeof(float));
+		layout.attributes[2] = attributeDesc(MESH_ATTRIBUTE_NORMAL, VERTEX_FLOAT, 3, 5 * sizeof(float));
+	}
+
+	// 把合并后的浮点顶点编码为量化布局，位置与纹理坐标按各自的包围盒反量化
+	void pack(std::vector<float>& data)
+	{
+		size_t count = data.size() / MESH_VERTEX_FLOATS;
+
+		float lo[5], hi[5];
+		for (int c = 0; c < 5; c++)
+		{
+			lo[c] = count > 0 ? data[c] : 0.0f;
+			hi[c] = lo[c];
+		}
+		for (size_t i = 0; i < count; i++)
+		{
+			for (int c = 0; c < 5; c++)
+			{
+				lo[c] = std::min(lo[c], data[i * MESH_VERTEX_FLOATS + c]);
+				hi[c] = std::max(hi[c], data[i * MESH_VERTEX_FLOATS + c]);
+			}
+		}
+
+		memset(&layout, 0, sizeof(layout));
+		layout.vertexStride = MESH_QUANTIZED_STRIDE;
+		layout.vertexCount = (uint32_t)count;
+		layout.attributeCount = 3;
+		layout.attributes[0] = attributeDesc(MESH_ATTRIBUTE_POSITION, VERTEX_UNORM16, 3, 0);
+		layout.attributes[1] = attributeDesc(MESH_ATTRIBUTE_TEXCOORD, VERTEX_UNORM16, 2, 3 * sizeof(uint16_t));
+		layout.attributes[2] = attributeDesc(MESH_ATTRIBUTE_NORMAL, VERTEX_OCT16, 3, 5 * sizeof(uint16_t));
+		for (int c = 0; c < 5; c++)
+		{
+			MeshAttributeDesc& desc = layout.attributes[c < 3 ? 0 : 1];
+			desc.scale[c < 3 ? c : c - 3] = (hi[c] - lo[c]) / 65535.0f;
+			desc.bias[c < 3 ? c : c - 3] = lo[c];
+		}
+
+		ownedVertices.assign(count * MESH_QUANTIZED_STRIDE, 0);
+		for (size_t i = 0; i < count; i++)
+		{
+			float *v = &data[i * MESH_VERTEX_FLOATS];
+			uint16_t q[5];
+			for (int c = 0; c < 5; c++) q[c] = encodeUnorm16(v[c], lo[c], hi[c] - lo[c]);
+
+			int16_t oct[2];
+			Vec3 n = { v[5], v[6], v[7] };
+			encodeOctahedral(n, oct);
+
+			BYTE *out = &ownedVertices[i * MESH_QUANTIZED_STRIDE];
+			memcpy(out, q, sizeof(q));
+			memcpy(out + sizeof(q), oct, sizeof(oct));
+		}
+	}
+
+	// 每级从上一级简化，三角形数减半，误差逐级累加；各级再单独做顶点缓存排序后接在索引块末尾
+	void buildLods(std::vector<float>& data)
+	{
+		auto start = std::chrono::steady_clock::now();
+		size_t count = data.size() / MESH_VERTEX_FLOATS;
+
+		Vec3 lo = Vec3(0.0f), hi = Vec3(0.0f);
+		for (size_t v = 0; v < count; v++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				float p = data[v * MESH_VERTEX_FLOATS + k];
+				lo[k] = (v == 0) ? p : std::min(lo[k], p);
+				hi[k] = (v == 0) ? p : std::max(hi[k], p);
+			}
+		}
+		Vec3 center = (lo + hi) * 0.5f;
+		float radius = 0.0f;
+		for (size_t v = 0; v < count; v++)
+		{
+			Vec3 p = { data[v * MESH_VERTEX_FLOATS], data[v * MESH_VERTEX_FLOATS + 1], data[v * MESH_VERTEX_FLOATS + 2] };
+			radius = std::max(radius, length(p - center));
+		}
+		for (int k = 0; k < 3; k++) layout.center[k] = center[k];
+		layout.radius = radius;
+
+		layout.lodCount = 1;
+		layout.lods[0] = { 0, (uint32_t)ownedIndices.size(), 0.0f, 0 };
+
+		std::vector<UINT> previous(ownedIndices);
+		float error = 0.0f;
+
+		while (layout.lodCount < MESH_MAX_LODS && previous.size() / 3 > MESH_LOD_MIN_TRIANGLES)
+		{
+			float stepError;
+			std::vector<UINT> lod = MeshSimplifier::simplify(previous, data.data(), count, MESH_VERTEX_FLOATS, previous.size() / 6 * 3, stepError);
+			if (lod.size() > previous.size() * MESH_LOD_MIN_REDUCTION) break;
+			if (error + stepError > radius * MESH_LOD_MAX_RELATIVE_ERROR) break;
+
+			error += stepError;
+			MeshOptimizer::optimizeVertexCache(lod, count);
+
+			layout.lods[layout.lodCount++] = { (uint32_t)ownedIndices.size(), (uint32_t)lod.size(), error, 0 };
+			ownedIndices.insert(ownedIndices.end(), lod.begin(), lod.end());
+			previous.swap(lod);
+		}
+
+		float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+		std::cout << "Built " << layout.lodCount << " LODs:";
+		for (uint32_t i = 0; i < layout.lodCount; i++) std::cout << " " << layout.lods[i].indexCount / 3 << " (" << layout.lods[i].error << ")";
+		std::cout << " in " << seconds << " s" << std::endl;
+	}
+
+	// 先写临时文件再改名，多个进程同时生成同一缓存时读者不会看到写了一半的文件
+	bool write(const std::string& path, uint64_t sourceSize, int64_t sourceTime)
+	{
+		MeshFileHeader header = makeHeader(sourceSize, sourceTime);
+
+		std::string tempPath = path + "." + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + ".tmp";
+		{
+			std::ofstream out(tempPath, std::ios::binary);
+			if (!out) return false;
+
+			char padding[MESH_BLOCK_ALIGNMENT] = {};
+
+			out.write((char*)&header, sizeof(header));
+			out.write(padding, header.vertexOffset - sizeof(header));
+			out.write((char*)ownedVertices.data(), ownedVertices.size());
+			out.write(padding, header.indexOffset - header.vertexOffset - (uint64_t)header.vertexCount * header.vertexStride);
+			out.write((char*)ownedIndices.data(), ownedIndices.size() * sizeof(UINT));
+
+			if (!out)
+			{
+				out.close();
+				std::remove(tempPath.c_str());
+				return false;
+			}
+		}
+
+#ifdef _WIN32
+		std::remove(path.c_str());
+#endif
+		if (std::rename(tempPath.c_str(), path.c_str()) != 0)
+		{
+			std::remove(tempPath.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	MappedFile file;
+	// 当前顶点块的布局，只用到vertexStride、vertexCount与attributes
+	MeshFileHeader layout = {};
+	UINT *indexData = nullptr;
+	std::vector<BYTE> ownedVertices;
+	std::vector<UINT> ownedIndices;
+};
+
+#endif
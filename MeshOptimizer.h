@@ -0,0 +1,379 @@
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+#include "Platform.h"
+#include "math/Vector.h"
+#include "PipelineData.h"
+
+// Forsyth顶点缓存优化的参数：按VertexProcessor的先进先出缓存（VERTEX_CACHE_SIZE项）建模，
+// 命中不会刷新位置，缓存中的顶点越旧越快被挤出，得分从最新的FORSYTH_CACHE_MIN_SCORE线性增加到1，先用掉快要被挤出的；
+// 剩余三角形少的顶点额外加分，尽早用完
+const float FORSYTH_CACHE_MIN_SCORE = 0.5f;
+const float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+const float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+
+// 统计过度绘制时每个方向的正交视图分辨率
+const int OVERDRAW_GRID_SIZE = 256;
+
+// 加载时的网格优化，依次做三步：
+// 1. 顶点缓存：Forsyth的贪心排序，每次输出与缓存中顶点相邻、得分最高的三角形，使后变换缓存命中更多
+// 2. 过度绘制：把上一步的序列切成缓存局部性仍好的簇，朝外的簇先画，让它们挡住后面的片元
+// 3. 顶点读取：按首次被索引的顺序重排顶点，取顶点时基本顺序访问内存
+// 顶点为连续的float，每个顶点stride个，前3个为位置
+class MeshOptimizer
+{
+public:
+	static void optimizeVertexCache(std::vector<UINT>& indices, size_t vertexCount)
+	{
+		size_t triangleCount = indices.size() / 3;
+		if (triangleCount == 0) return;
+
+		// 每个顶点相邻的三角形，用完的三角形从列表中移走
+		std::vector<UINT> adjacencyOffset(vertexCount + 1, 0);
+		std::vector<UINT> remaining(vertexCount, 0);
+		for (size_t i = 0; i < triangleCount * 3; i++) remaining[indices[i]]++;
+		for (size_t v = 0; v < vertexCount; v++) adjacencyOffset[v + 1] = adjacencyOffset[v] + remaining[v];
+
+		std::vector<UINT> adjacency(triangleCount * 3);
+		{
+			std::vector<UINT> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+			for (size_t t = 0; t < triangleCount; t++)
+			{
+				for (int k = 0; k < 3; k++) adjacency[fill[indices[t * 3 + k]]++] = (UINT)t;
+			}
+		}
+
+		std::vector<int> cachePosition(vertexCount, -1);
+		std::vector<float> vertexScore(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++) vertexScore[v] = forsythScore(-1, remaining[v]);
+
+		std::vector<bool> emitted(triangleCount, false);
+
+		std::vector<UINT> result;
+		result.reserve(indices.size());
+
+		// 按进入缓存的先后从新到旧排列
+		UINT cache[VERTEX_CACHE_SIZE];
+		int cacheCount = 0;
+		size_t cursor = 0;
+		long best = -1;
+
+		for (size_t n = 0; n < triangleCount; n++)
+		{
+			// 缓存附近没有可用的三角形时按原顺序取下一个未输出的
+			if (best < 0)
+			{
+				while (emitted[cursor]) cursor++;
+				best = (long)cursor;
+			}
+
+			UINT *tri = &indices[best * 3];
+			emitted[best] = true;
+			result.insert(result.end(), tri, tri + 3);
+
+			for (int k = 0; k < 3; k++)
+			{
+				UINT v = tri[k];
+				UINT *begin = &adjacency[adjacencyOffset[v]];
+				UINT *end = begin + remaining[v];
+				*std::find(begin, end, (UINT)best) = *(end - 1);
+				remaining[v]--;
+			}
+
+			// 新缓存：先进先出，命中的顶点位置不变，未命中的顶点插在最前面，最旧的被挤出
+			UINT newCache[VERTEX_CACHE_SIZE + 3];
+			int newCount = 0;
+			for (int k = 0; k < 3; k++)
+			{
+				if (cachePosition[tri[k]] < 0 && std::find(newCache, newCache + newCount, tri[k]) == newCache + newCount) newCache[newCount++] = tri[k];
+			}
+			for (int c = 0; c < cacheCount; c++) newCache[newCount++] = cache[c];
+
+			cacheCount = 0;
+			for (int c = 0; c < newCount; c++)
+			{
+				UINT v = newCache[c];
+				if (c < VERTEX_CACHE_SIZE) cache[cacheCount++] = v;
+				cachePosition[v] = (c < VERTEX_CACHE_SIZE) ? c : -1;
+				vertexScore[v] = forsythScore(cachePosition[v], remaining[v]);
+			}
+
+			// 下一个三角形只从与缓存中顶点相邻的三角形里挑
+			best = -1;
+			float bestScore = -FLT_MAX;
+			for (int c = 0; c < cacheCount; c++)
+			{
+				UINT v = cache[c];
+				for (UINT a = 0; a < remaining[v]; a++)
+				{
+					UINT t = adjacency[adjacencyOffset[v] + a];
+					float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+					if (score > bestScore)
+					{
+						bestScore = score;
+						best = t;
+					}
+				}
+			}
+		}
+
+		indices.swap(result);
+	}
+
+	// 先在已优化顶点缓存的序列上切簇：后变换缓存全部未命中的三角形处必须切开，
+	// 其余位置在簇从空缓存开始的ACMR不超过整段的threshold倍时切开，簇被挪走后命中率最多下降这个比例
+	// 再按簇的平均法线与簇中心相对网格中心的方向排序，越朝外的簇越先画
+	static void optimizeOverdraw(std::vector<UINT>& indices, float *vertices, size_t vertexCount, size_t stride, float threshold = 1.05f)
+	{
+		size_t triangleCount = indices.size() / 3;
+		if (triangleCount == 0) return;
+
+		std::vector<int> misses(triangleCount);
+		size_t totalMisses = simulateCache(indices, &misses[0]);
+
+		std::vector<size_t> clusters;
+		for (size_t start = 0; start < triangleCount;)
+		{
+			size_t end = start + 1;
+			int hardMisses = misses[start];
+			while (end < triangleCount && misses[end] < 3) hardMisses += misses[end++];
+			float hardACMR = (float)hardMisses / (end - start);
+
+			UINT cache[VERTEX_CACHE_SIZE];
+			std::fill(cache, cache + VERTEX_CACHE_SIZE, VERTEX_CACHE_EMPTY);
+			int head = 0;
+			int softMisses = 0;
+			size_t softStart = start;
+			for (size_t t = start; t < end; t++)
+			{
+				softMisses += fetchTriangle(cache, head, &indices[t * 3]);
+				if (t + 1 < end && (float)softMisses / (t + 1 - softStart) <= threshold * hardACMR)
+				{
+					clusters.push_back(softStart);
+					softStart = t + 1;
+					softMisses = 0;
+					std::fill(cache, cache + VERTEX_CACHE_SIZE, VERTEX_CACHE_EMPTY);
+				}
+			}
+			clusters.push_back(softStart);
+			start = end;
+		}
+
+		Vec3 meshCenter = Vec3(0.0f);
+		for (size_t v = 0; v < vertexCount; v++) meshCenter = meshCenter + position(vertices, stride, v);
+		if (vertexCount > 0) meshCenter = meshCenter / (float)vertexCount;
+
+		struct Cluster
+		{
+			size_t start, end;
+			float sortKey;
+		};
+		std::vector<Cluster> sorted(clusters.size());
+
+		for (size_t c = 0; c < clusters.size(); c++)
+		{
+			size_t start = clusters[c];
+			size_t end = (c + 1 < clusters.size()) ? clusters[c + 1] : triangleCount;
+
+			// 面积加权的中心与法线，叉积的长度即两倍面积
+			Vec3 center = Vec3(0.0f), normal = Vec3(0.0f);
+			float area = 0.0f;
+			for (size_t t = start; t < end; t++)
+			{
+				Vec3 a = position(vertices, stride, indices[t * 3]);
+				Vec3 b = position(vertices, stride, indices[t * 3 + 1]);
+				Vec3 c3 = position(vertices, stride, indices[t * 3 + 2]);
+				Vec3 n = cross(b - a, c3 - a);
+				float w = length(n);
+				center = center + (a + b + c3) * (w / 3.0f);
+				normal = normal + n;
+				area += w;
+			}
+			if (area > 0.0f) center = center / area;
+			float normalLength = length(normal);
+			if (normalLength > 0.0f) normal = normal / normalLength;
+
+			sorted[c] = { start, end, dot(center - meshCenter, normal) };
+		}
+
+		std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+		std::vector<UINT> result;
+		result.reserve(indices.size());
+		for (auto& cluster : sorted) result.insert(result.end(), indices.begin() + cluster.start * 3, indices.begin() + cluster.end * 3);
+
+		// 每段末尾剩下的簇不受threshold约束，允许两倍的损失；几乎每个三角形都是硬边界的网格
+		// （如面法线各不相同的低模）重排后会丢掉更多命中，此时保留原顺序
+		if (simulateCache(result, nullptr) <= totalMisses * (2.0f * threshold - 1.0f)) indices.swap(result);
+	}
+
+	// 按首次被索引的顺序给顶点重新编号并搬动顶点数据，没被引用的顶点丢弃
+	static void optimizeVertexFetch(std::vector<UINT>& indices, std::vector<float>& vertices, size_t stride)
+	{
+		size_t vertexCount = vertices.size() / stride;
+		std::vector<UINT> remap(vertexCount, VERTEX_CACHE_EMPTY);
+		std::vector<float> result;
+		result.reserve(vertices.size());
+
+		UINT next = 0;
+		for (auto& index : indices)
+		{
+			if (remap[index] == VERTEX_CACHE_EMPTY)
+			{
+				remap[index] = next++;
+				result.insert(result.end(), vertices.begin() + index * stride, vertices.begin() + (index + 1) * stride);
+			}
+			index = remap[index];
+		}
+
+		vertices.swap(result);
+	}
+
+	// 平均每个三角形的顶点着色次数（ACMR），按顶点阶段同样大小的先进先出缓存统计，最好约为0.5
+	static float analyzeVertexCache(std::vector<UINT>& indices)
+	{
+		size_t triangleCount = indices.size() / 3;
+		if (triangleCount == 0) return 0.0f;
+		return (float)simulateCache(indices, nullptr) / triangleCount;
+	}
+
+	// 沿6个坐标轴方向正交投影并剔除背面，按索引顺序带深度测试光栅化，
+	// 返回通过深度测试的片元数与被覆盖像素数之比，1表示没有过度绘制
+	static float analyzeOverdraw(std::vector<UINT>& indices, float *vertices, size_t vertexCount, size_t stride)
+	{
+		if (indices.empty() || vertexCount == 0) return 0.0f;
+
+		Vec3 lo = position(vertices, stride, 0), hi = lo;
+		for (size_t v = 1; v < vertexCount; v++)
+		{
+			Vec3 p = position(vertices, stride, v);
+			for (int k = 0; k < 3; k++) lo[k] = std::min(lo[k], p[k]), hi[k] = std::max(hi[k], p[k]);
+		}
+		float extent = std::max(hi[0] - lo[0], std::max(hi[1] - lo[1], hi[2] - lo[2]));
+		if (extent <= 0.0f) return 0.0f;
+		float scale = (OVERDRAW_GRID_SIZE - 1) / extent;
+
+		std::vector<float> depth(OVERDRAW_GRID_SIZE * OVERDRAW_GRID_SIZE);
+		size_t shaded = 0, covered = 0;
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			for (int sign = -1; sign <= 1; sign += 2)
+			{
+				std::fill(depth.begin(), depth.end(), FLT_MAX);
+				int u = (axis + 1) % 3, w = (axis + 2) % 3;
+
+				for (size_t t = 0; t < indices.size() / 3; t++)
+				{
+					Vec3 p[3];
+					for (int k = 0; k < 3; k++)
+					{
+						Vec3 q = position(vertices, stride, indices[t * 3 + k]);
+						p[k] = { (q[u] - lo[u]) * scale, (q[w] - lo[w]) * scale, (q[axis] - lo[axis]) * scale * sign };
+					}
+
+					// 观察者在-sign一侧，逆时针为正面，法线须指向观察者
+					Vec3 n = cross(p[1] - p[0], p[2] - p[0]);
+					if (n[2] * sign >= 0.0f) continue;
+
+					shaded += rasterize(p, depth);
+				}
+
+				for (auto d : depth) covered += (d != FLT_MAX);
+			}
+		}
+
+		return covered > 0 ? (float)shaded / covered : 0.0f;
+	}
+
+private:
+	static Vec3 position(float *vertices, size_t stride, size_t index)
+	{
+		float *p = vertices + index * stride;
+		return { p[0], p[1], p[2] };
+	}
+
+	static float forsythScore(int cachePosition, UINT remaining)
+	{
+		if (remaining == 0) return -1.0f;
+
+		float score = 0.0f;
+		if (cachePosition >= 0)
+		{
+			score = FORSYTH_CACHE_MIN_SCORE + (1.0f - FORSYTH_CACHE_MIN_SCORE) * (cachePosition + 1) / VERTEX_CACHE_SIZE;
+		}
+		return score + FORSYTH_VALENCE_BOOST_SCALE * std::pow((float)remaining, -FORSYTH_VALENCE_BOOST_POWER);
+	}
+
+	// 与VertexProcessor相同的先进先出缓存，返回总未命中数，misses非空时记下每个三角形的未命中数
+	static size_t simulateCache(std::vector<UINT>& indices, int *misses)
+	{
+		UINT cache[VERTEX_CACHE_SIZE];
+		std::fill(cache, cache + VERTEX_CACHE_SIZE, VERTEX_CACHE_EMPTY);
+		int head = 0;
+		size_t total = 0;
+
+		for (size_t t = 0; t < indices.size() / 3; t++)
+		{
+			int count = fetchTriangle(cache, head, &indices[t * 3]);
+			if (misses != nullptr) misses[t] = count;
+			total += count;
+		}
+		return total;
+	}
+
+	static int fetchTriangle(UINT *cache, int& head, UINT *tri)
+	{
+		int count = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			if (std::find(cache, cache + VERTEX_CACHE_SIZE, tri[k]) != cache + VERTEX_CACHE_SIZE) continue;
+
+			cache[head] = tri[k];
+			head = (head + 1) % VERTEX_CACHE_SIZE;
+			count++;
+		}
+		return count;
+	}
+
+	// 以像素中心采样的半空间光栅化，深度小者可见，返回通过深度测试的像素数
+	static size_t rasterize(Vec3 p[3], std::vector<float>& depth)
+	{
+		float area = (p[1][0] - p[0][0]) * (p[2][1] - p[0][1]) - (p[1][1] - p[0][1]) * (p[2][0] - p[0][0]);
+		if (area == 0.0f) return 0;
+
+		int minX = std::max(0, (int)std::floor(std::min(p[0][0], std::min(p[1][0], p[2][0]))));
+		int maxX = std::min(OVERDRAW_GRID_SIZE - 1, (int)std::ceil(std::max(p[0][0], std::max(p[1][0], p[2][0]))));
+		int minY = std::max(0, (int)std::floor(std::min(p[0][1], std::min(p[1][1], p[2][1]))));
+		int maxY = std::min(OVERDRAW_GRID_SIZE - 1, (int)std::ceil(std::max(p[0][1], std::max(p[1][1], p[2][1]))));
+
+		size_t passed = 0;
+		for (int y = minY; y <= maxY; y++)
+		{
+			for (int x = minX; x <= maxX; x++)
+			{
+				float px = x + 0.5f, py = y + 0.5f;
+				float w0 = ((p[2][0] - p[1][0]) * (py - p[1][1]) - (p[2][1] - p[1][1]) * (px - p[1][0])) / area;
+				float w1 = ((p[0][0] - p[2][0]) * (py - p[2][1]) - (p[0][1] - p[2][1]) * (px - p[2][0])) / area;
+				float w2 = 1.0f - w0 - w1;
+				if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) continue;
+
+				float z = w0 * p[0][2] + w1 * p[1][2] + w2 * p[2][2];
+				float& stored = depth[y * OVERDRAW_GRID_SIZE + x];
+				if (z < stored)
+				{
+					stored = z;
+					passed++;
+				}
+			}
+		}
+		return passed;
+	}
+};
+
+#endif
@@ -0,0 +1,266 @@
+#ifndef MESHSIMPLIFIER_H
+#define MESHSIMPLIFIER_H
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+
+#include "Platform.h"
+#include "math/Vector.h"
+
+// 边折叠时新三角形法线与原法线夹角的余弦下限，低于它视为翻转
+const float SIMPLIFY_FLIP_COS = 0.2f;
+
+// 二次误差度量（QEM）的网格简化：每个顶点累积相邻三角形所在平面按面积加权的二次型，
+// 把顶点折叠到相邻的另一个顶点上，代价为合并后的二次型在目标位置的值除以总面积，
+// 即到这些平面距离平方的面积加权平均，每轮按代价从小到大折叠
+// 只做半边折叠（目标是已有顶点），结果索引仍指向原顶点数组，各级LOD可以共用一份顶点
+// 纹理坐标或法线不连续处（同一位置有多个顶点）与开放边界上的顶点不移动，保持接缝与轮廓
+class MeshSimplifier
+{
+public:
+	// 把indices简化到不超过targetIndexCount个索引，error返回几何误差（模型空间中的均方根距离）
+	// 接缝、边界或翻转限制使简化无法继续时提前停止
+	static std::vector<UINT> simplify(std::vector<UINT>& indices, float *vertices, size_t vertexCount, size_t stride,
+		size_t targetIndexCount, float& error)
+	{
+		error = 0.0f;
+		std::vector<UINT> result = indices;
+		if (result.size() <= targetIndexCount) return result;
+
+		std::vector<bool> locked = lockedVertices(indices, vertices, vertexCount, stride);
+
+		std::vector<Quadric> quadrics(vertexCount);
+		for (size_t t = 0; t < indices.size() / 3; t++)
+		{
+			UINT *tri = &indices[t * 3];
+			Vec3 a = position(vertices, stride, tri[0]);
+			Vec3 n = cross(position(vertices, stride, tri[1]) - a, position(vertices, stride, tri[2]) - a);
+			float area = length(n);
+			if (area == 0.0f) continue;
+
+			n = n / area;
+			Quadric plane(n, -dot(n, a), area);
+			for (int k = 0; k < 3; k++) quadrics[tri[k]] += plane;
+		}
+
+		std::vector<UINT> remap(vertexCount);
+		std::vector<bool> touched(vertexCount);
+		std::vector<UINT> adjacencyOffset(vertexCount + 1);
+		std::vector<UINT> adjacency;
+		float maxCost = 0.0f;
+
+		while (result.size() > targetIndexCount)
+		{
+			size_t triangleCount = result.size() / 3;
+
+			// 每轮重建顶点到三角形的邻接
+			std::fill(adjacencyOffset.begin(), adjacencyOffset.end(), 0);
+			for (auto index : result) adjacencyOffset[index + 1]++;
+			for (size_t v = 0; v < vertexCount; v++) adjacencyOffset[v + 1] += adjacencyOffset[v];
+			adjacency.resize(result.size());
+			{
+				std::vector<UINT> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+				for (size_t t = 0; t < triangleCount; t++)
+				{
+					for (int k = 0; k < 3; k++) adjacency[fill[result[t * 3 + k]]++] = (UINT)t;
+				}
+			}
+
+			std::vector<Collapse> collapses;
+			collapses.reserve(result.size());
+			for (size_t t = 0; t < triangleCount; t++)
+			{
+				for (int k = 0; k < 3; k++)
+				{
+					UINT a = result[t * 3 + k], b = result[t * 3 + (k + 1) % 3];
+					if (!locked[a]) collapses.push_back({ a, b, collapseCost(quadrics, vertices, stride, a, b) });
+					if (!locked[b]) collapses.push_back({ b, a, collapseCost(quadrics, vertices, stride, b, a) });
+				}
+			}
+			if (collapses.empty()) break;
+
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+			for (size_t v = 0; v < vertexCount; v++) remap[v] = (UINT)v;
+			std::fill(touched.begin(), touched.end(), false);
+
+			// 每次折叠约去掉两个三角形，一轮内涉及的顶点不再参与，保证翻转检查用的是最新的三角形
+			size_t removeTarget = (result.size() - targetIndexCount + 2) / 3;
+			size_t removed = 0;
+
+			for (auto& collapse : collapses)
+			{
+				if (removed >= removeTarget) break;
+				if (touched[collapse.from] || touched[collapse.to]) continue;
+				if (flips(result, adjacency, adjacencyOffset, vertices, stride, collapse.from, collapse.to)) continue;
+
+				for (UINT a = adjacencyOffset[collapse.from]; a < adjacencyOffset[collapse.from + 1]; a++)
+				{
+					UINT *tri = &result[adjacency[a] * 3];
+					if (tri[0] == collapse.to || tri[1] == collapse.to || tri[2] == collapse.to) removed++;
+					for (int k = 0; k < 3; k++) touched[tri[k]] = true;
+				}
+
+				remap[collapse.from] = collapse.to;
+				quadrics[collapse.to] += quadrics[collapse.from];
+				maxCost = std::max(maxCost, collapse.cost);
+			}
+			if (removed == 0) break;
+
+			size_t write = 0;
+			for (size_t t = 0; t < triangleCount; t++)
+			{
+				UINT a = remap[result[t * 3]], b = remap[result[t * 3 + 1]], c = remap[result[t * 3 + 2]];
+				if (a == b || b == c || c == a) continue;
+				result[write++] = a, result[write++] = b, result[write++] = c;
+			}
+			result.resize(write);
+		}
+
+		error = std::sqrt(maxCost);
+		return result;
+	}
+
+private:
+	// 对称4x4矩阵的10个元素，平面 n·p + d = 0 的二次型为 weight * (n, d)(n, d)^T
+	struct Quadric
+	{
+		Quadric() { memset(m, 0, sizeof(m)); }
+		Quadric(Vec3 n, float d, float weight)
+		{
+			double a = n[0], b = n[1], c = n[2];
+			double v[10] = { a * a, a * b, a * c, a * d, b * b, b * c, b * d, c * c, c * d, (double)d * d };
+			for (int i = 0; i < 10; i++) m[i] = v[i] * weight;
+			w = weight;
+		}
+
+		void operator += (Quadric& q)
+		{
+			for (int i = 0; i < 10; i++) m[i] += q.m[i];
+			w += q.w;
+		}
+
+		// p^T A p + 2 b·p + c，即p到各平面距离平方的加权和
+		double evaluate(Vec3 p)
+		{
+			double x = p[0], y = p[1], z = p[2];
+			return m[0] * x * x + 2.0 * m[1] * x * y + 2.0 * m[2] * x * z + 2.0 * m[3] * x
+				+ m[4] * y * y + 2.0 * m[5] * y * z + 2.0 * m[6] * y
+				+ m[7] * z * z + 2.0 * m[8] * z
+				+ m[9];
+		}
+
+		double m[10];
+		double w = 0.0;
+	};
+
+	struct Collapse
+	{
+		UINT from, to;
+		float cost;
+	};
+
+	static Vec3 position(float *vertices, size_t stride, size_t index)
+	{
+		float *p = vertices + index * stride;
+		return { p[0], p[1], p[2] };
+	}
+
+	static float collapseCost(std::vector<Quadric>& quadrics, float *vertices, size_t stride, UINT from, UINT to)
+	{
+		Vec3 p = position(vertices, stride, to);
+		double weight = quadrics[from].w + quadrics[to].w;
+		if (weight <= 0.0) return 0.0f;
+
+		double cost = (quadrics[from].evaluate(p) + quadrics[to].evaluate(p)) / weight;
+		return (float)std::max(cost, 0.0);
+	}
+
+	// 与别的顶点共享位置（接缝）或位于开放边界上的顶点
+	static std::vector<bool> lockedVertices(std::vector<UINT>& indices, float *vertices, size_t vertexCount, size_t stride)
+	{
+		struct PositionHash
+		{
+			size_t operator () (const Vec3& p) const
+			{
+				uint32_t bits[3];
+				memcpy(bits, &p, sizeof(bits));
+				return (size_t)(bits[0] * 73856093u ^ bits[1] * 19349663u ^ bits[2] * 83492791u);
+			}
+		};
+		struct PositionEqual
+		{
+			bool operator () (const Vec3& a, const Vec3& b) const { return memcmp(&a, &b, sizeof(Vec3)) == 0; }
+		};
+
+		std::unordered_map<Vec3, UINT, PositionHash, PositionEqual> first;
+		first.reserve(vertexCount);
+		std::vector<UINT> group(vertexCount);
+		std::vector<UINT> groupSize(vertexCount, 0);
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			group[v] = first.emplace(position(vertices, stride, v), (UINT)v).first->second;
+			groupSize[group[v]]++;
+		}
+
+		// 按位置统计每条边被几个三角形使用，只被一个使用的是边界
+		std::unordered_map<uint64_t, UINT> edges;
+		edges.reserve(indices.size());
+		for (size_t t = 0; t < indices.size() / 3; t++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				UINT a = group[indices[t * 3 + k]], b = group[indices[t * 3 + (k + 1) % 3]];
+				edges[edgeKey(a, b)]++;
+			}
+		}
+
+		std::vector<bool> locked(vertexCount, false);
+		std::vector<bool> borderGroup(vertexCount, false);
+		for (auto& edge : edges)
+		{
+			if (edge.second != 1) continue;
+			borderGroup[(UINT)(edge.first >> 32)] = true;
+			borderGroup[(UINT)(edge.first & 0xffffffff)] = true;
+		}
+		for (size_t v = 0; v < vertexCount; v++) locked[v] = groupSize[group[v]] > 1 || borderGroup[group[v]];
+		return locked;
+	}
+
+	static uint64_t edgeKey(UINT a, UINT b)
+	{
+		return a < b ? ((uint64_t)a << 32 | b) : ((uint64_t)b << 32 | a);
+	}
+
+	// from移到to后，from周围不含to的三角形是否翻转或退化
+	static bool flips(std::vector<UINT>& indices, std::vector<UINT>& adjacency, std::vector<UINT>& adjacencyOffset,
+		float *vertices, size_t stride, UINT from, UINT to)
+	{
+		Vec3 target = position(vertices, stride, to);
+
+		for (UINT a = adjacencyOffset[from]; a < adjacencyOffset[from + 1]; a++)
+		{
+			UINT *tri = &indices[adjacency[a] * 3];
+			if (tri[0] == to || tri[1] == to || tri[2] == to) continue;
+
+			Vec3 p[3], q[3];
+			for (int k = 0; k < 3; k++)
+			{
+				p[k] = position(vertices, stride, tri[k]);
+				q[k] = (tri[k] == from) ? target : p[k];
+			}
+
+			Vec3 before = cross(p[1] - p[0], p[2] - p[0]);
+			Vec3 after = cross(q[1] - q[0], q[2] - q[0]);
+			float lengths = length(before) * length(after);
+			if (lengths == 0.0f || dot(before, after) < SIMPLIFY_FLIP_COS * lengths) return true;
+		}
+		return false;
+	}
+};
+
+#endif
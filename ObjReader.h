@@ -2,90 +2,447 @@
 #define OBJREADER_H
 
 #include <iostream>
-#include <fstream>
-#include <sstream>
+#include <vector>
+#include <thread>
+#include <chrono>
 #include <cstring>
-#include <cstdio>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
 
 #include "Buffer.h"
+#include "MappedFile.h"
 #include "math/Vector.h"
 
+// 小于这个大小的文件不再切分，避免线程开销超过解析本身
+const size_t OBJ_MIN_CHUNK_SIZE = 256 * 1024;
+
+// 文件映射到内存后按行边界切成若干块并行解析，每块得到自己的顶点属性与面，
+// 再按各块的属性数量前缀和把索引换算成全局下标，最后并行展开成逐顶点的数组
+// 输出格式不变：每个三角形3个顶点，每个顶点依次为位置(3)、纹理坐标(2)、法线(3)
+// 面支持 v、v/t、v//n、v/t/n 与任意边数的多边形（按扇形三角化），索引可为负（相对当前已读的数量）
+// 缺少纹理坐标时取(0, 0)，缺少法线时用三角形的面法线
 struct ObjReader
 {
 	std::vector<float> readFile(const char* filePath)
 	{
 		std::vector<float> data;
-		std::fstream file(filePath);
 		std::cout << "Loading Obj: " << filePath << std::endl;
 
-		if (!file.is_open())
+		auto start = std::chrono::steady_clock::now();
+
+		MappedFile file;
+		if (!file.open(filePath))
 		{
 			std::cout << "Error loading Obj" << std::endl;
 			return data;
 		}
 
+		const char *begin = file.data();
+		const char *end = begin + file.size();
+
+		int chunkCount = (int)std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), file.size() / OBJ_MIN_CHUNK_SIZE + 1);
+		std::vector<Chunk> chunks(chunkCount);
+
+		// 切分点向后移到下一行开头，每行只属于一个块
+		std::vector<const char*> bounds(chunkCount + 1);
+		bounds[0] = begin;
+		bounds[chunkCount] = end;
+		for (int i = 1; i < chunkCount; i++)
+		{
+			const char *p = std::max(bounds[i - 1], begin + file.size() / chunkCount * i);
+			while (p < end && *p != '\n') p++;
+			bounds[i] = (p < end) ? p + 1 : end;
+		}
+
+		parallelFor(chunkCount, [&](int i) { parseChunk(bounds[i], bounds[i + 1], chunks[i]); });
+
+		// 各块之前已读到的位置、纹理坐标、法线数量，负索引与之相加
+		int counts[3] = { 0, 0, 0 };
+		std::vector<int> triangleOffsets(chunkCount + 1, 0);
+		for (int i = 0; i < chunkCount; i++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				chunks[i].base[k] = counts[k];
+				counts[k] += chunks[i].attributeCount(k);
+			}
+			triangleOffsets[i + 1] = triangleOffsets[i] + chunks[i].triangleCount;
+		}
+
+		std::vector<Vec3> points, normals;
+		std::vector<Vec2> texCoords;
+		points.reserve(counts[0]), texCoords.reserve(counts[1]), normals.reserve(counts[2]);
+		for (auto& chunk : chunks)
+		{
+			points.insert(points.end(), chunk.points.begin(), chunk.points.end());
+			texCoords.insert(texCoords.end(), chunk.texCoords.begin(), chunk.texCoords.end());
+			normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+		}
+
+		data.resize((size_t)triangleOffsets[chunkCount] * 3 * 8);
+
+		std::vector<int> skipped(chunkCount, 0);
+		parallelFor(chunkCount, [&](int i)
+		{
+			skipped[i] = expandChunk(chunks[i], points, texCoords, normals, &data[(size_t)triangleOffsets[i] * 3 * 8]);
+		});
+
+		// 跳过的面在各块末尾留下了空位，按顺序压紧
+		int skippedFaces = 0;
+		size_t write = 0;
+		for (int i = 0; i < chunkCount; i++)
+		{
+			size_t read = (size_t)triangleOffsets[i] * 3 * 8;
+			size_t length = (size_t)(chunks[i].triangleCount - skipped[i]) * 3 * 8;
+			if (write != read) memmove(&data[write], &data[read], length * sizeof(float));
+			write += length;
+			skippedFaces += chunks[i].skippedFaces;
+		}
+		data.resize(write);
+
+		float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+		float megabytes = file.size() / (1024.0f * 1024.0f);
+
+		if (skippedFaces > 0)
+		{
+			std::cout << "Skipped " << skippedFaces << " faces with invalid indices" << std::endl;
+		}
+		std::cout << "Loaded " << data.size() / 24 << " triangles, " << megabytes << " MB in " << seconds << " s ("
+			<< (seconds > 0.0f ? megabytes / seconds : 0.0f) << " MB/s, " << chunkCount << " threads)" << std::endl;
+
+		return data;
+	}
+
+private:
+	// 面的一个顶点：正数为从1开始的全局索引，负数在读取时已换算为块内下标（从0开始，可能指向之前的块），
+	// 由relative标记；0表示没有该属性
+	struct Corner
+	{
+		int index[3];
+		BYTE relative;
+	};
+
+	struct Chunk
+	{
+		int attributeCount(int k)
+		{
+			return k == 0 ? (int)points.size() : (k == 1 ? (int)texCoords.size() : (int)normals.size());
+		}
+
 		std::vector<Vec3> points;
 		std::vector<Vec2> texCoords;
 		std::vector<Vec3> normals;
 
-		std::string line;
-		while (std::getline(file, line))
+		std::vector<Corner> corners;
+		std::vector<int> faceSizes;
+		int triangleCount = 0;
+		int skippedFaces = 0;
+
+		int base[3] = { 0, 0, 0 };
+	};
+
+	template<typename Func>
+	static void parallelFor(int count, Func func)
+	{
+		if (count == 1)
+		{
+			func(0);
+			return;
+		}
+
+		std::vector<std::thread> threads;
+		for (int i = 0; i < count; i++) threads.emplace_back(func, i);
+		for (auto& thread : threads) thread.join();
+	}
+
+	static bool isSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	static bool isDigit(char c)
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	static const char* skipSpaces(const char *p, const char *end)
+	{
+		while (p < end && isSpace(*p)) p++;
+		return p;
+	}
+
+	static const char* skipLine(const char *p, const char *end)
+	{
+		while (p < end && *p != '\n') p++;
+		return p < end ? p + 1 : end;
+	}
+
+	// 十进制尾数最多取19位整数累加，再乘10的幂，只在最后舍入；没有数字时返回nullptr
+	static const char* parseFloat(const char *p, const char *end, float& out)
+	{
+		static const double powers[] =
 		{
-			if (line.empty()) continue;
-			if (line[0] != 'v' && line[0] != 'f') continue;
+			1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+		};
 
-			std::stringstream ss;
-			ss << line;
+		p = skipSpaces(p, end);
 
-			std::string type;
-			ss >> type;
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
 
-			if (type == "f")
+		uint64_t mantissa = 0;
+		int exponent = 0, digits = 0;
+		bool any = false;
+
+		for (; p < end && isDigit(*p); p++)
+		{
+			any = true;
+			if (digits < 19)
 			{
-				int indexP[3], indexT[3], indexN[3];
-
-				const char *buf = line.c_str();
-				sscanf
-				(
-					buf + 1,
-					"%d/%d/%d %d/%d/%d %d/%d/%d",
-					&indexP[0], &indexT[0], &indexN[0],
-					&indexP[1], &indexT[1], &indexN[1],
-					&indexP[2], &indexT[2], &indexN[2]
-				);
-
-				for (int i = 0; i < 3; i++)
-				{
-					Vec3 p = points[indexP[i] - 1];
-					Vec2 t = texCoords[indexT[i] - 1];
-					Vec3 n = normals[indexT[i] - 1];
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa != 0) digits++;
+			}
+			else exponent++;
+		}
 
-					for (int j = 0; j < 3; j++) data.push_back(p[j]);
-					for (int j = 0; j < 2; j++) data.push_back(t[j]);
-					for (int j = 0; j < 3; j++) data.push_back(n[j]);
+		if (p < end && *p == '.')
+		{
+			for (p++; p < end && isDigit(*p); p++)
+			{
+				any = true;
+				if (digits < 19)
+				{
+					mantissa = mantissa * 10 + (*p - '0');
+					if (mantissa != 0) digits++;
+					exponent--;
 				}
 			}
-			else if (type == "v")
+		}
+
+		if (!any) return nullptr;
+
+		if (p < end && (*p == 'e' || *p == 'E'))
+		{
+			const char *q = p + 1;
+			bool expNegative = false;
+			if (q < end && (*q == '-' || *q == '+')) expNegative = (*q++ == '-');
+
+			if (q < end && isDigit(*q))
+			{
+				int value = 0;
+				for (; q < end && isDigit(*q); q++) value = std::min(value * 10 + (*q - '0'), 10000);
+				exponent += expNegative ? -value : value;
+				p = q;
+			}
+		}
+
+		double value = (double)mantissa;
+		if (exponent < 0) value = (exponent >= -22) ? value / powers[-exponent] : value * std::pow(10.0, exponent);
+		else if (exponent > 0) value = (exponent <= 22) ? value * powers[exponent] : value * std::pow(10.0, exponent);
+
+		out = (float)(negative ? -value : value);
+		return p;
+	}
+
+	static const char* parseInt(const char *p, const char *end, int& out)
+	{
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
+		if (p >= end || !isDigit(*p)) return nullptr;
+
+		int value = 0;
+		for (; p < end && isDigit(*p); p++) value = value * 10 + (*p - '0');
+
+		out = negative ? -value : value;
+		return p;
+	}
+
+	template<int N>
+	static const char* parseVec(const char *p, const char *end, Vec<N>& v)
+	{
+		for (int i = 0; i < N; i++)
+		{
+			const char *next = parseFloat(p, end, v[i]);
+			if (next == nullptr) break;
+			p = next;
+		}
+		return p;
+	}
+
+	static void parseChunk(const char *p, const char *end, Chunk& chunk)
+	{
+		while (p < end)
+		{
+			p = skipSpaces(p, end);
+			if (p >= end) break;
+
+			if (p + 1 < end && p[0] == 'v' && isSpace(p[1]))
 			{
 				Vec3 v;
-				ss >> v[0] >> v[1] >> v[2];
-				points.push_back(v);
+				p = parseVec(p + 1, end, v);
+				chunk.points.push_back(v);
 			}
-			else if (type == "vt")
+			else if (p + 2 < end && p[0] == 'v' && p[1] == 't' && isSpace(p[2]))
 			{
 				Vec2 v;
-				ss >> v[0] >> v[1];
-				texCoords.push_back(v);
+				p = parseVec(p + 2, end, v);
+				chunk.texCoords.push_back(v);
 			}
-			else if (type == "vn")
+			else if (p + 2 < end && p[0] == 'v' && p[1] == 'n' && isSpace(p[2]))
 			{
 				Vec3 v;
-				ss >> v[0] >> v[1] >> v[2];
-				normals.push_back(v);
+				p = parseVec(p + 2, end, v);
+				chunk.normals.push_back(v);
 			}
+			else if (p + 1 < end && p[0] == 'f' && isSpace(p[1]))
+			{
+				p = parseFace(p + 1, end, chunk);
+			}
+
+			p = skipLine(p, end);
 		}
+	}
 
-		return data;
+	static const char* parseFace(const char *p, const char *end, Chunk& chunk)
+	{
+		int size = 0;
+		bool valid = true;
+
+		while (true)
+		{
+			p = skipSpaces(p, end);
+			if (p >= end || *p == '\n' || *p == '#') break;
+
+			Corner corner = { { 0, 0, 0 }, 0 };
+
+			// v、v/t、v//n、v/t/n
+			for (int k = 0; k < 3; k++)
+			{
+				if (k > 0)
+				{
+					if (p >= end || *p != '/') break;
+					p++;
+					if (k == 1 && p < end && *p == '/') continue;
+				}
+
+				int value;
+				const char *next = parseInt(p, end, value);
+				if (next == nullptr)
+				{
+					if (k == 0) valid = false;
+					continue;
+				}
+				p = next;
+
+				if (value < 0)
+				{
+					corner.index[k] = chunk.attributeCount(k) + value;
+					corner.relative |= 1 << k;
+				}
+				else corner.index[k] = value;
+			}
+
+			if (!valid)
+			{
+				p = skipLine(p, end) - 1;
+				break;
+			}
+
+			chunk.corners.push_back(corner);
+			size++;
+		}
+
+		if (!valid || size < 3)
+		{
+			chunk.corners.resize(chunk.corners.size() - size);
+			chunk.skippedFaces++;
+			return p;
+		}
+
+		chunk.faceSizes.push_back(size);
+		chunk.triangleCount += size - 2;
+		return p;
+	}
+
+	// 换算为从0开始的全局下标，没有该属性时为-1，越界时返回false
+	static bool resolve(Chunk& chunk, Corner& corner, int k, int count, int& index)
+	{
+		if (corner.relative & (1 << k)) index = chunk.base[k] + corner.index[k];
+		else if (corner.index[k] == 0)
+		{
+			index = -1;
+			return k != 0;
+		}
+		else index = corner.index[k] - 1;
+
+		return index >= 0 && index < count;
+	}
+
+	// 返回因索引越界跳过的三角形数，写入的三角形连续存放在out开头
+	static int expandChunk(
+			Chunk& chunk,
+			std::vector<Vec3>& points,
+			std::vector<Vec2>& texCoords,
+			std::vector<Vec3>& normals,
+			float *out)
+	{
+		int counts[3] = { (int)points.size(), (int)texCoords.size(), (int)normals.size() };
+		int skippedTriangles = 0;
+		size_t first = 0;
+
+		for (int size : chunk.faceSizes)
+		{
+			Corner *face = &chunk.corners[first];
+			first += size;
+
+			int indices[3][3];
+			bool valid = true;
+
+			for (int c = 0; c < size && valid; c++)
+			{
+				int index;
+				for (int k = 0; k < 3; k++) valid = valid && resolve(chunk, face[c], k, counts[k], index);
+			}
+
+			if (!valid)
+			{
+				chunk.skippedFaces++;
+				skippedTriangles += size - 2;
+				continue;
+			}
+
+			for (int t = 1; t + 1 < size; t++)
+			{
+				Corner *triangle[3] = { &face[0], &face[t], &face[t + 1] };
+				for (int c = 0; c < 3; c++)
+				{
+					for (int k = 0; k < 3; k++) resolve(chunk, *triangle[c], k, counts[k], indices[c][k]);
+				}
+
+				Vec3 faceNormal(0.0f);
+				if (indices[0][2] < 0 || indices[1][2] < 0 || indices[2][2] < 0)
+				{
+					Vec3& p0 = points[indices[0][0]];
+					faceNormal = cross(points[indices[1][0]] - p0, points[indices[2][0]] - p0);
+					if (faceNormal.length() > 0.0f) faceNormal = faceNormal.normalized();
+				}
+
+				for (int c = 0; c < 3; c++)
+				{
+					Vec3 p = points[indices[c][0]];
+					Vec2 t = indices[c][1] >= 0 ? texCoords[indices[c][1]] : Vec2(0.0f);
+					Vec3 n = indices[c][2] >= 0 ? normals[indices[c][2]] : faceNormal;
+
+					for (int j = 0; j < 3; j++) *out++ = p[j];
+					for (int j = 0; j < 2; j++) *out++ = t[j];
+					for (int j = 0; j < 3; j++) *out++ = n[j];
+				}
+			}
+		}
+
+		return skippedTriangles;
 	}
 };
 
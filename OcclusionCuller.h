@@ -0,0 +1,173 @@
+#ifndef OCCLUSIONCULLER_H
+#define OCCLUSIONCULLER_H
+
+#include <vector>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include <type_traits>
+
+#include "math/Vector.h"
+#include "math/Matrix.h"
+#include "FrameBufferAdapter.h"
+#include "FrameBufferDouble.h"
+#include "VertexProcessor.h"
+#include "Rasterizer.h"
+#include "FragmentProcessor.h"
+#include "ShadowSampler.h"
+#include "Scene.h"
+#include "Arena.h"
+
+// 遮挡深度缓冲相对于屏幕的缩小倍数
+const int OCCLUSION_DOWNSCALE = 4;
+
+// 软件遮挡剔除：少量大的遮挡物以低分辨率只写深度，覆盖范围向内收缩一个像素后得到保守的深度，
+// 再逐级取2x2最大值建成深度金字塔；物体包围盒投影到屏幕的矩形在合适的一级最多覆盖2x2个纹素，
+// 包围盒最近的深度比这几个纹素的最大深度还远就整个被挡住，不必提交draw
+// 在主线程同步完成，不经过Renderer的队列
+class OcclusionCuller
+{
+public:
+	void init(int width, int height)
+	{
+		depth.init(std::max(width, 1), std::max(height, 1), 1);
+		adapter.depthAttachment = &depth;
+		levels.clear();
+	}
+
+	int width() { return depth.width(); }
+	int height() { return depth.height(); }
+
+	// 每帧画遮挡物之前调用，view、proj与主相机相同
+	void begin(Mat4 view, Mat4 proj)
+	{
+		viewProj = proj * view;
+		depth.fill(1.0f);
+		arena.reset();
+		levels.clear();
+	}
+
+	// 复用只写深度的顶点与光栅化路径，model为遮挡物的模型矩阵
+	template<typename VertexArray, typename IndexArray = std::vector<UINT>>
+	void addOccluder(VertexArray& vertexArray, Mat4 model, IndexArray *indices = nullptr)
+	{
+		ShadowShader<typename std::decay<decltype(vertexArray[0])>::type> shader;
+		shader.lightMVP = viewProj * model;
+
+		ArenaVector<Pipeline::FSIn<Pipeline::NoVaryings>> vertices =
+			VertexProcessor::processPosition(vertexArray, shader, { (float)width(), (float)height() }, arena, indices);
+		ArenaVector<Pipeline::Quad<Pipeline::NoVaryings>> fragments = Rasterizer::rasterize(vertices, CULL_BACK, arena);
+		FragmentProcessor::processDepth(adapter, fragments);
+	}
+
+	// 遮挡物画完后调用
+	// 每个像素取周围3x3共9个像素中心深度的最大值：像素内任意一点都在这些中心围成的范围内，
+	// 平面遮挡物的深度在屏幕上线性变化，这样得到的值不小于像素内任意一点的深度，只被部分覆盖的边缘像素也变为空
+	void buildPyramid()
+	{
+		int w = width(), h = height();
+		levels.assign(1, std::vector<float>(w * h));
+		levelWidth.assign(1, w);
+
+		FrameBuffer<float>& buf = depth.getCurrentBuffer();
+		for (int y = 0; y < h; y++)
+		{
+			for (int x = 0; x < w; x++)
+			{
+				float farthest = 0.0f;
+				for (int dy = -1; dy <= 1; dy++)
+				{
+					// 深度按行翻转存储，与FrameBufferAdapter::writeDepth一致；屏幕边缘外按边缘像素算
+					int row = h - std::min(std::max(y + dy, 0), h - 1) - 1;
+					for (int dx = -1; dx <= 1; dx++)
+					{
+						farthest = std::max(farthest, buf(std::min(std::max(x + dx, 0), w - 1), row));
+					}
+				}
+				levels[0][y * w + x] = farthest;
+			}
+		}
+
+		while (w > 1 || h > 1)
+		{
+			int nw = (w + 1) / 2, nh = (h + 1) / 2;
+			std::vector<float>& src = levels.back();
+			std::vector<float> dst(nw * nh);
+
+			for (int y = 0; y < nh; y++)
+			{
+				for (int x = 0; x < nw; x++)
+				{
+					int x0 = x * 2, x1 = std::min(x * 2 + 1, w - 1);
+					int y0 = y * 2, y1 = std::min(y * 2 + 1, h - 1);
+					dst[y * nw + x] = std::max(std::max(src[y0 * w + x0], src[y0 * w + x1]), std::max(src[y1 * w + x0], src[y1 * w + x1]));
+				}
+			}
+
+			levels.push_back(std::move(dst));
+			levelWidth.push_back(nw);
+			w = nw, h = nh;
+		}
+	}
+
+	// 世界空间的包围盒是否被遮挡物完全挡住；跨过近平面或投影到屏幕外的一律视为可见
+	bool occluded(Bounds& bounds)
+	{
+		if (levels.empty() || bounds.empty()) return false;
+
+		float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+		float nearest = FLT_MAX;
+
+		for (int corner = 0; corner < 8; corner++)
+		{
+			Vec4 p =
+			{
+				(corner & 1) ? bounds.hi[0] : bounds.lo[0],
+				(corner & 2) ? bounds.hi[1] : bounds.lo[1],
+				(corner & 4) ? bounds.hi[2] : bounds.lo[2],
+				1.0f
+			};
+			Vec4 clip = viewProj * p;
+			if (clip[3] <= 0.0f || clip[2] < 0.0f) return false;
+
+			float x = (clip[0] / clip[3] + 1.0f) / 2.0f * width();
+			float y = (clip[1] / clip[3] + 1.0f) / 2.0f * height();
+			minX = std::min(minX, x), maxX = std::max(maxX, x);
+			minY = std::min(minY, y), maxY = std::max(maxY, y);
+			nearest = std::min(nearest, clip[2] / clip[3]);
+		}
+
+		int x0 = std::max((int)std::floor(minX), 0), x1 = std::min((int)std::floor(maxX), width() - 1);
+		int y0 = std::max((int)std::floor(minY), 0), y1 = std::min((int)std::floor(maxY), height() - 1);
+		if (x0 > x1 || y0 > y1) return false;
+
+		// 矩形的长边不超过这一级一个纹素的宽度，最多跨2x2个纹素
+		int span = std::max(x1 - x0, y1 - y0) + 1;
+		int level = 0;
+		while ((1 << level) < span && level < (int)levels.size() - 1) level++;
+
+		int w = levelWidth[level];
+		float farthest = 0.0f;
+		for (int y = y0 >> level; y <= (y1 >> level); y++)
+		{
+			for (int x = x0 >> level; x <= (x1 >> level); x++)
+			{
+				farthest = std::max(farthest, levels[level][y * w + x]);
+			}
+		}
+
+		return nearest > farthest;
+	}
+
+private:
+	FrameBufferDouble<float> depth;
+	FrameBufferAdapter adapter;
+	FrameArena arena;
+	Mat4 viewProj;
+
+	// 第0级为收缩后的深度，按屏幕坐标（y向上）逐行存放，之后每级宽高减半
+	std::vector<std::vector<float>> levels;
+	std::vector<int> levelWidth;
+};
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef OCCLUSIONQUERY_H
+#define OCCLUSIONQUERY_H
+
+#include <atomic>
+#include <cstdint>
+
+// 遮挡查询：Renderer::beginQuery与endQuery之间的draw通过深度测试的片元数
+// 计数在片元阶段进行，流水线模式下结果要等这些命令执行完才可用，通常在之后的帧读取；
+// 没有完成过的查询不视为被遮挡，同一个查询对象在上一轮完成前再次begin只会推迟结果
+struct OcclusionQuery
+{
+	OcclusionQuery() {}
+	OcclusionQuery(const OcclusionQuery&) = delete;
+	OcclusionQuery& operator = (const OcclusionQuery&) = delete;
+
+	// 至少完成过一轮
+	bool available() { return ready.load(std::memory_order_acquire); }
+
+	// 最近完成的一轮的片元数
+	uint64_t result() { return completed.load(std::memory_order_acquire); }
+
+	// 上一轮结果为0，条件渲染据此跳过draw
+	bool occluded() { return available() && result() == 0; }
+
+	// 以下由Renderer在命令执行时修改
+	std::atomic<uint64_t> samples{ 0 };
+	std::atomic<uint64_t> completed{ 0 };
+	std::atomic<bool> ready{ false };
+};
+
+#endif
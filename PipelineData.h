@@ -3,10 +3,21 @@
 
 #include <vector>
 
+#include "Platform.h"
 #include "math/Math.h"
 #include "math/Vector.h"
 #include "math/Matrix.h"
 
+// 可见性缓冲中的编号：高位为一帧内的draw序号，低VISIBILITY_TRIANGLE_BITS位为draw内裁剪后的三角形序号
+const int VISIBILITY_TRIANGLE_BITS = 24;
+const UINT VISIBILITY_TRIANGLE_MASK = (1u << VISIBILITY_TRIANGLE_BITS) - 1;
+const UINT VISIBILITY_MAX_DRAWS = (1u << (32 - VISIBILITY_TRIANGLE_BITS)) - 1;
+const UINT VISIBILITY_EMPTY = 0xffffffff;
+
+// 顶点阶段后变换缓存的项数，网格优化器按同样大小的先进先出缓存统计ACMR
+const int VERTEX_CACHE_SIZE = 16;
+const UINT VERTEX_CACHE_EMPTY = 0xffffffff;
+
 namespace Pipeline
 {
 	template<typename VSToFS>
@@ -23,6 +34,14 @@ namespace Pipeline
 		Vec4 sr_Position;
 	};
 
+	// 不带任何插值数据，用于只写深度的pass
+	struct NoVaryings
+	{
+		NoVaryings() {}
+		NoVaryings(NoVaryings& from, NoVaryings& to, float weight) {}
+		NoVaryings(NoVaryings& va, NoVaryings& vb, NoVaryings& vc, Vec3 weight) {}
+	};
+
 	template<typename VSToFS>
 	struct FSIn
 	{
@@ -33,11 +52,153 @@ namespace Pipeline
 			w = dot(weight, Vec3{ a.w, b.w, c.w });
 			Vec3 correctedWeight = (weight * Vec3{ a.w, b.w, c.w }) / w;
 			data = VSToFS(a.data, b.data, c.data, correctedWeight);
+
+			// 记下所属三角形的顶点，供片元着色时求屏幕空间偏导
+			vertices[0] = &a, vertices[1] = &b, vertices[2] = &c;
+		}
+
+		// 单独拷贝出来的片元已不在quad中，lane置为-1，不能再按this - lane找相邻lane；
+		// Quad自己的拷贝会保留各lane的序号
+		FSIn(const FSIn& other) { *this = other; }
+
+		FSIn& operator = (const FSIn& other)
+		{
+			data = other.data;
+			x = other.x, y = other.y;
+			z = other.z, w = other.w;
+			vertices[0] = other.vertices[0], vertices[1] = other.vertices[1], vertices[2] = other.vertices[2];
+			lane = -1;
+			return *this;
+		}
+
+		// 变量member在屏幕x、y方向上的偏导
+		// 属于quad的片元直接与同一quad中相邻lane做差（同一行求x向、同一列求y向）；
+		// 不在quad中的片元用(x+1, y)、(x, y+1)处的透视校正权重与本片元做差分
+		template<typename T>
+		void derivatives(T VSToFS::*member, T& ddx, T& ddy)
+		{
+			if (lane >= 0)
+			{
+				// lanes在Quad中连续存放，按自身偏移找回lane 0
+				FSIn *lanes = this - lane;
+				int row = lane & 2, column = lane & 1;
+
+				ddx = lanes[row | 1].data.*member - lanes[row].data.*member;
+				ddy = lanes[2 | column].data.*member - lanes[column].data.*member;
+				return;
+			}
+
+			Vec3 dWdx, dWdy;
+			weightDerivatives(dWdx, dWdy);
+
+			T& va = vertices[0]->data.*member;
+			T& vb = vertices[1]->data.*member;
+			T& vc = vertices[2]->data.*member;
+
+			ddx = triLerp(va, vb, vc, dWdx);
+			ddy = triLerp(va, vb, vc, dWdy);
+		}
+
+		template<typename T>
+		T dFdx(T VSToFS::*member)
+		{
+			T ddx, ddy;
+			derivatives(member, ddx, ddy);
+			return ddx;
+		}
+
+		template<typename T>
+		T dFdy(T VSToFS::*member)
+		{
+			T ddx, ddy;
+			derivatives(member, ddx, ddy);
+			return ddy;
+		}
+
+		void weightDerivatives(Vec3& dWdx, Vec3& dWdy)
+		{
+			dWdx = dWdy = Vec3(0.0f);
+			if (vertices[0] == nullptr) return;
+
+			Vec2 va = { (float)vertices[0]->x, (float)vertices[0]->y };
+			Vec2 vb = { (float)vertices[1]->x, (float)vertices[1]->y };
+			Vec2 vc = { (float)vertices[2]->x, (float)vertices[2]->y };
+
+			float area = cross(vc - va, vb - va);
+			if (std::abs(area) <= 1e-3f) return;
+
+			Vec3 vw = { vertices[0]->w, vertices[1]->w, vertices[2]->w };
+			Vec3 w0 = correctedWeight(va, vb, vc, vw, area, { (float)x, (float)y });
+
+			dWdx = correctedWeight(va, vb, vc, vw, area, { (float)x + 1.0f, (float)y }) - w0;
+			dWdy = correctedWeight(va, vb, vc, vw, area, { (float)x, (float)y + 1.0f }) - w0;
 		}
 
 		VSToFS data;
 		int x, y;
 		float z, w;
+		FSIn *vertices[3] = { nullptr, nullptr, nullptr };
+		// 在所属Quad中的序号，-1表示不在quad中
+		int lane = -1;
+
+	private:
+		static Vec3 correctedWeight(Vec2& va, Vec2& vb, Vec2& vc, Vec3& vw, float area, Vec2 p)
+		{
+			Vec3 weight =
+			{
+				cross(vc - p, vb - p) / area,
+				cross(va - p, vc - p) / area,
+				cross(vb - p, va - p) / area
+			};
+			weight *= vw;
+			return weight / (weight[0] + weight[1] + weight[2]);
+		}
+	};
+
+	// 可见性缓冲光栅化的输出，不带任何插值数据
+	struct VisibilityFragment
+	{
+		int x, y;
+		float z;
+		UINT id;
+	};
+
+	// 光栅化与着色的基本单位：2x2像素块，lanes依次为(x, y)、(x + 1, y)、(x, y + 1)、(x + 1, y + 1)
+	// mask中未置位的lane是辅助片元，属性外插自同一三角形，只用于求偏导，不做深度测试也不写缓冲
+	template<typename VSToFS>
+	struct Quad
+	{
+		Quad() {}
+		Quad(const Quad& other) { *this = other; }
+
+		// 整体拷贝时lanes仍连续存放，保留各lane的序号
+		Quad& operator = (const Quad& other)
+		{
+			for (int i = 0; i < 4; i++)
+			{
+				lanes[i] = other.lanes[i];
+				lanes[i].lane = other.lanes[i].lane;
+			}
+			mask = other.mask;
+			return *this;
+		}
+
+		FSIn<VSToFS>& operator [] (int i) { return lanes[i]; }
+
+		bool active(int i) const
+		{
+			return (mask >> i) & 1;
+		}
+
+		// quad内共用的偏导（取lane 0所在行与列），用于整个quad共用一个mip级别
+		template<typename T>
+		void derivatives(T VSToFS::*member, T& ddx, T& ddy)
+		{
+			lanes[0].derivatives(member, ddx, ddy);
+		}
+
+		FSIn<VSToFS> lanes[4];
+		int mask = 0;
 	};
 }
 
@@ -0,0 +1,18 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+// Windows以外的平台（如无界面的Linux渲染节点）补上用到的几个Win32类型与键码
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <cstdint>
+#include <cstring>
+
+typedef unsigned char BYTE;
+typedef unsigned int UINT;
+
+#define VK_SHIFT 0x10
+#define VK_SPACE 0x20
+#endif
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef PRESENTER_H
+#define PRESENTER_H
+
+#include <iostream>
+#include <fstream>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include "FrameBuffer.h"
+
+// 异步呈现队列：渲染线程提交画好的缓冲后立即返回，由独立线程把它交给sink
+// 配合三缓冲使用，第N帧呈现的同时第N+1帧可以继续渲染
+template<typename T>
+class Presenter
+{
+public:
+	typedef std::function<void(FrameBuffer<T>&)> Sink;
+
+	Presenter() {}
+
+	~Presenter()
+	{
+		stop();
+	}
+
+	void start(Sink sink)
+	{
+		stop();
+		this->sink = sink;
+		running = true;
+		thread = std::thread(&Presenter::run, this);
+	}
+
+	// 等待队列中剩余的帧呈现完毕后结束线程
+	void stop()
+	{
+		if (!thread.joinable()) return;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			running = false;
+		}
+		queueChanged.notify_all();
+		thread.join();
+	}
+
+	void submit(FrameBuffer<T> *buf)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			queue.push_back(buf);
+		}
+		queueChanged.notify_all();
+	}
+
+	// 阻塞直到buf不在队列中也不在呈现中，之后渲染线程才能重新写入它
+	void wait(FrameBuffer<T> *buf)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		queueChanged.wait(lock, [&]() { return !pending(buf); });
+	}
+
+	size_t presentedCount()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return presented;
+	}
+
+	static Sink nullSink()
+	{
+		return [](FrameBuffer<T>& buf) {};
+	}
+
+	// 逐帧写出原始像素，可以是文件也可以是管道（如std::cout）
+	static Sink streamSink(std::ostream& out)
+	{
+		return [&out](FrameBuffer<T>& buf)
+		{
+			out.write((const char*)buf.bufPtr(), (size_t)buf.width * buf.height * sizeof(T));
+			out.flush();
+		};
+	}
+
+private:
+	bool pending(FrameBuffer<T> *buf)
+	{
+		if (buf == presenting) return true;
+		for (auto b : queue)
+		{
+			if (b == buf) return true;
+		}
+		return false;
+	}
+
+	void run()
+	{
+		while (true)
+		{
+			FrameBuffer<T> *buf;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				queueChanged.wait(lock, [&]() { return !queue.empty() || !running; });
+
+				if (queue.empty()) break;
+
+				buf = queue.front();
+				queue.pop_front();
+				presenting = buf;
+			}
+
+			sink(*buf);
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				presenting = nullptr;
+				presented++;
+			}
+			queueChanged.notify_all();
+		}
+	}
+
+private:
+	Sink sink;
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable queueChanged;
+
+	std::deque<FrameBuffer<T>*> queue;
+	FrameBuffer<T> *presenting = nullptr;
+	bool running = false;
+	size_t presented = 0;
+};
+
+#endif
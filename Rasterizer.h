@@ -12,6 +12,7 @@
 #include "Primitive.h"
 #include "PipelineData.h"
 #include "LineDrawer.h"
+#include "Arena.h"
 
 enum
 {
@@ -23,32 +24,112 @@ enum
 class Rasterizer
 {
 public:
+	// 输出按三角形顺序排列的2x2 quad
+	template<typename VSToFS>
+	static ArenaVector<Pipeline::Quad<VSToFS>> rasterize(
+			ArenaVector<Pipeline::FSIn<VSToFS>>& vertexData,
+			int cullFaceMode,
+			FrameArena& arena)
+	{
+		typedef Pipeline::FSIn<VSToFS> VertexData;
+		typedef Pipeline::Quad<VSToFS> Quad;
+
+		return processTriangles<Quad>(vertexData, cullFaceMode, arena,
+			[](ArenaVector<Quad>& output, VertexData& va, VertexData& vb, VertexData& vc, int index)
+			{
+				processTriangle(output, va, vb, vc);
+			});
+	}
+
+	// 可见性缓冲用：不插值任何属性，每个像素只输出深度与drawId | 三角形序号
+	template<typename VSToFS>
+	static ArenaVector<Pipeline::VisibilityFragment> rasterizeVisibility(
+			ArenaVector<Pipeline::FSIn<VSToFS>>& vertexData,
+			int cullFaceMode,
+			UINT drawId,
+			FrameArena& arena)
+	{
+		typedef Pipeline::FSIn<VSToFS> VertexData;
+		typedef Pipeline::VisibilityFragment Fragment;
+
+		return processTriangles<Fragment>(vertexData, cullFaceMode, arena,
+			[drawId](ArenaVector<Fragment>& output, VertexData& va, VertexData& vb, VertexData& vc, int index)
+			{
+				processTriangleVisibility(output, va, vb, vc, (drawId << VISIBILITY_TRIANGLE_BITS) | ((UINT)index & VISIBILITY_TRIANGLE_MASK));
+			});
+	}
+
+	// 光栅化时三角形顶点按y排序，重建片元属性时需要同样的顺序才能得到相同的重心坐标
 	template<typename VertexData>
-	static std::vector<VertexData> rasterize(
-			std::vector<VertexData>& vertexData,
-			int cullFaceMode)
+	static void sortVertices(VertexData* sorted[3])
+	{
+		for (int i = 0; i < 2; i++)
+		{
+			for (int j = 0; j < 2; j++)
+			{
+				if (sorted[j]->y > sorted[j + 1]->y)
+				{
+					std::swap(sorted[j], sorted[j + 1]);
+				}
+			}
+		}
+	}
+
+	static Vec3 getWeight(Vec2& va, Vec2& vb, Vec2& vc, Vec2& p)
+	{
+		const float eps = 1e-3;
+
+		if (equals(va, vb, eps) && equals(vb, vc, eps)) return Vec3(1.0f) / 3.0f;
+		if (equals(va, vb, eps)) return Vec3{ (vc - p).length() / 2.0f, (vc - p).length() / 2.0f, (p - va).length() } / ((vc - va).length() + eps);
+		if (equals(vb, vc, eps)) return Vec3{ (va - p).length() / 2.0f, (va - p).length() / 2.0f, (p - vb).length() } / ((va - vb).length() + eps);
+		if (equals(vc, va, eps)) return Vec3{ (vb - p).length() / 2.0f, (vb - p).length() / 2.0f, (p - vc).length() } / ((vb - vc).length() + eps);
+
+		float area = cross(vc - va, vb - va);
+
+		if (std::abs(area) <= eps)
+		{
+			return Vec3(1.0f) / 3.0f;
+		}
+
+		float la = cross(vc - p, vb - p) / area;
+		float lb = cross(va - p, vc - p) / area;
+		float lc = cross(vb - p, va - p) / area;
+
+		return { la, lb, lc };
+	}
+
+private:
+	// 三角形平均分给各线程，每个线程输出到自己的数组，最后按线程顺序拼接，保持三角形的提交顺序
+	template<typename Output, typename VertexData, typename Process>
+	static ArenaVector<Output> processTriangles(
+			ArenaVector<VertexData>& vertexData,
+			int cullFaceMode,
+			FrameArena& arena,
+			Process process)
 	{
-		std::vector<VertexData> outData;
+		ArenaVector<Output> outData(arena);
 
 		int triangleCount = vertexData.size() / 3;
 
 		const int maxThreads = std::thread::hardware_concurrency();
 
-		std::vector<VertexData> triangles[maxThreads];
+		std::vector<ArenaVector<Output>> triangles(maxThreads, ArenaVector<Output>(arena));
 		std::thread threads[maxThreads];
 
 		for (int i = 0; i < maxThreads; i++)
 		{
-			int start = (triangleCount / maxThreads) * i;
-			int end = std::min(triangleCount, (triangleCount / maxThreads) * (i + 1));
+			// 余数分散到各线程，最后一个线程的end正好是triangleCount
+			int start = triangleCount * i / maxThreads;
+			int end = triangleCount * (i + 1) / maxThreads;
 
 			threads[i] = std::thread
 			(
-				processTriangles<VertexData>,
+				processTriangleRange<Output, VertexData, Process>,
 				std::ref(triangles[i]),
 				std::ref(vertexData),
 				start, end,
-				cullFaceMode
+				cullFaceMode,
+				process
 			);
 		}
 
@@ -57,6 +138,13 @@ public:
 			thread.join();
 		}
 
+		size_t fragmentCount = 0;
+		for (int i = 0; i < maxThreads; i++)
+		{
+			fragmentCount += triangles[i].size();
+		}
+		outData.reserve(fragmentCount);
+
 		for (int i = 0; i < maxThreads; i++)
 		{
 			outData.insert(outData.end(), triangles[i].begin(), triangles[i].end());
@@ -65,20 +153,20 @@ public:
 		return outData;
 	}
 
-private:
-	template<typename VertexData>
-	static void processTriangles(
-		std::vector<VertexData>& outData,
-		std::vector<VertexData>& vertexData,
+	template<typename Output, typename VertexData, typename Process>
+	static void processTriangleRange(
+		ArenaVector<Output>& outData,
+		ArenaVector<VertexData>& vertexData,
 		int start,
 		int end,
-		int cullFaceMode)
+		int cullFaceMode,
+		Process process)
 	{
 		for (register int i = start; i < end; i++)
 		{
-			VertexData va = vertexData[i * 3 + 0];
-			VertexData vb = vertexData[i * 3 + 1];
-			VertexData vc = vertexData[i * 3 + 2];
+			VertexData& va = vertexData[i * 3 + 0];
+			VertexData& vb = vertexData[i * 3 + 1];
+			VertexData& vc = vertexData[i * 3 + 2];
 
 			if (cullFaceMode)
 			{
@@ -86,48 +174,22 @@ private:
 				if (coef * cross(Vec2{ float(vc.x - va.x), float(vc.y - va.y) }, Vec2{ float(vb.x - va.x), float(vb.y - va.y) }) > 0.0f) continue;
 			}
 
-			std::vector<VertexData> triangle = processTriangle(va, vb, vc);
-
-			outData.insert(outData.end(), triangle.begin(), triangle.end());
+			process(outData, va, vb, vc, i);
 		}
 	}
 
-
-	template<typename VertexData>
-	static std::vector<VertexData> processTriangle(
-			VertexData& v0,
-			VertexData& v1,
-			VertexData& v2)
+	// 扫描线起止位置：三条边用Bresenham走一遍，记下每行最左与最右的x，sx、ex长度为ty - by + 1
+	static void scanSpans(float x0, float y0, float x1, float y1, float x2, float y2, int *sx, int *ex, int rows)
 	{
-		std::vector<VertexData> output;
-
-		VertexData sorted[] = { v0, v1, v2 };
-		for (int i = 0; i < 2; i++)
-		{
-			for (int j = 0; j < 2; j++)
-			{
-				if (sorted[j].y > sorted[j + 1].y)
-				{
-					std::swap(sorted[j], sorted[j + 1]);
-				}
-			}
-		}
+		int by = y0;
 
-		float x0 = sorted[0].x, y0 = sorted[0].y;
-		float x1 = sorted[1].x, y1 = sorted[1].y;
-		float x2 = sorted[2].x, y2 = sorted[2].y;
-		int ty = y2, by = y0;
-
-		// 扫描线光栅化，生成片段
 		LineDrawer ab(x0, y0, x1, y1);
 		LineDrawer bc(x1, y1, x2, y2);
 		LineDrawer ac(x0, y0, x2, y2);
 		LineDrawer* dw[] = { &ab, &bc, &ac };
 
-		int sx[ty - by + 1], ex[ty - by + 1];
-
-		memset(sx, 0x3f, sizeof(sx));
-		memset(ex, 0x00, sizeof(ex));
+		memset(sx, 0x3f, sizeof(int) * rows);
+		memset(ex, 0x00, sizeof(int) * rows);
 
 		for (int i = 0; i < 3; i++)
 		{
@@ -145,51 +207,121 @@ private:
 			sx[y - by] = std::min(sx[y - by], x);
 			ex[y - by] = std::max(ex[y - by], x);
 		}
+	}
+
+	template<typename VSToFS>
+	static void processTriangle(
+			ArenaVector<Pipeline::Quad<VSToFS>>& output,
+			Pipeline::FSIn<VSToFS>& v0,
+			Pipeline::FSIn<VSToFS>& v1,
+			Pipeline::FSIn<VSToFS>& v2)
+	{
+		typedef Pipeline::FSIn<VSToFS> VertexData;
+
+		// 只排指针，片元记录的是vertexData中原顶点的地址
+		VertexData* sorted[] = { &v0, &v1, &v2 };
+		sortVertices(sorted);
+
+		float x0 = sorted[0]->x, y0 = sorted[0]->y;
+		float x1 = sorted[1]->x, y1 = sorted[1]->y;
+		float x2 = sorted[2]->x, y2 = sorted[2]->y;
+		int ty = y2, by = y0;
+
+		// 扫描线光栅化，生成片段
+		int sx[ty - by + 1], ex[ty - by + 1];
+		scanSpans(x0, y0, x1, y1, x2, y2, sx, ex, ty - by + 1);
 
 		Vec2 va = { x0, y0 };
 		Vec2 vb = { x1, y1 };
 		Vec2 vc = { x2, y2 };
 
-		for (register int i = by; i <= ty; i++)
+		// 按两行一组、两列一组划分quad，覆盖范围仍由扫描线的起止位置决定
+		// quad中没有被覆盖的位置作为辅助片元，用同一三角形的重心坐标外插出属性
+		for (int qy = by - (by & 1); qy <= ty; qy += 2)
 		{
-			int l = sx[i - by], r = ex[i - by];
+			int l = 0x3f3f3f3f, r = 0;
+			for (int dy = 0; dy < 2; dy++)
+			{
+				int y = qy + dy;
+				if (y < by || y > ty) continue;
+
+				l = std::min(l, sx[y - by]);
+				r = std::max(r, ex[y - by]);
+			}
 
-			for (int j = l; j <= r; j++)
+			for (int qx = l - (l & 1); qx <= r; qx += 2)
 			{
-				Vec2 p = { (float)j, (float)i };
-				Vec3 weight = getWeight(va, vb, vc, p);
+				int mask = 0;
+				for (int lane = 0; lane < 4; lane++)
+				{
+					int x = qx + (lane & 1), y = qy + (lane >> 1);
+					if (y < by || y > ty) continue;
+					if (x >= sx[y - by] && x <= ex[y - by]) mask |= 1 << lane;
+				}
 
-				VertexData fragment(sorted[0], sorted[1], sorted[2], weight);
-				fragment.x = j;
-				fragment.y = i;
+				if (mask == 0) continue;
 
-				output.push_back(fragment);
+				Pipeline::Quad<VSToFS> quad;
+				quad.mask = mask;
+
+				for (int lane = 0; lane < 4; lane++)
+				{
+					Vec2 p = { (float)(qx + (lane & 1)), (float)(qy + (lane >> 1)) };
+					Vec3 weight = getWeight(va, vb, vc, p);
+
+					VertexData& fragment = quad.lanes[lane];
+					fragment = VertexData(*sorted[0], *sorted[1], *sorted[2], weight);
+					fragment.x = (int)p[0];
+					fragment.y = (int)p[1];
+					fragment.lane = lane;
+				}
+
+				output.push_back(quad);
 			}
 		}
-		return output;
 	}
 
-	static Vec3 getWeight(Vec2& va, Vec2& vb, Vec2& vc, Vec2& p)
+	template<typename VSToFS>
+	static void processTriangleVisibility(
+			ArenaVector<Pipeline::VisibilityFragment>& output,
+			Pipeline::FSIn<VSToFS>& v0,
+			Pipeline::FSIn<VSToFS>& v1,
+			Pipeline::FSIn<VSToFS>& v2,
+			UINT id)
 	{
-		const float eps = 1e-3;
+		typedef Pipeline::FSIn<VSToFS> VertexData;
 
-		if (equals(va, vb, eps) && equals(vb, vc, eps)) return Vec3(1.0f) / 3.0f;
-		if (equals(va, vb, eps)) return Vec3{ (vc - p).length() / 2.0f, (vc - p).length() / 2.0f, (p - va).length() } / ((vc - va).length() + eps);
-		if (equals(vb, vc, eps)) return Vec3{ (va - p).length() / 2.0f, (va - p).length() / 2.0f, (p - vb).length() } / ((va - vb).length() + eps);
-		if (equals(vc, va, eps)) return Vec3{ (vb - p).length() / 2.0f, (vb - p).length() / 2.0f, (p - vc).length() } / ((vb - vc).length() + eps);
+		VertexData* sorted[] = { &v0, &v1, &v2 };
+		sortVertices(sorted);
 
-		float area = cross(vc - va, vb - va);
+		float x0 = sorted[0]->x, y0 = sorted[0]->y;
+		float x1 = sorted[1]->x, y1 = sorted[1]->y;
+		float x2 = sorted[2]->x, y2 = sorted[2]->y;
+		int ty = y2, by = y0;
+
+		int sx[ty - by + 1], ex[ty - by + 1];
+		scanSpans(x0, y0, x1, y1, x2, y2, sx, ex, ty - by + 1);
+
+		Vec2 va = { x0, y0 };
+		Vec2 vb = { x1, y1 };
+		Vec2 vc = { x2, y2 };
+		Vec3 vz = { sorted[0]->z, sorted[1]->z, sorted[2]->z };
 
-		if (abs(area) <= eps)
+		for (register int i = by; i <= ty; i++)
 		{
-			return Vec3(1.0f) / 3.0f;
-		}
+			for (int j = sx[i - by]; j <= ex[i - by]; j++)
+			{
+				Vec2 p = { (float)j, (float)i };
 
-		float la = cross(vc - p, vb - p) / area;
-		float lb = cross(va - p, vc - p) / area;
-		float lc = cross(vb - p, va - p) / area;
+				Pipeline::VisibilityFragment fragment;
+				fragment.x = j;
+				fragment.y = i;
+				fragment.z = dot(getWeight(va, vb, vc, p), vz);
+				fragment.id = id;
 
-		return { la, lb, lc };
+				output.push_back(fragment);
+			}
+		}
 	}
 };
 
@@ -0,0 +1,117 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+#include <algorithm>
+
+// 按提交顺序在后台线程执行命令的队列，Renderer用它把片元阶段挪到后台，
+// 让下一个draw的顶点处理与当前draw的片元着色重叠
+// 每条命令完成后completed加一，提交时返回的序号可作为fence等待
+class RenderQueue
+{
+public:
+	typedef std::function<void()> Command;
+
+	RenderQueue() {}
+
+	~RenderQueue()
+	{
+		stop();
+	}
+
+	void start()
+	{
+		if (thread.joinable()) return;
+		running = true;
+		thread = std::thread(&RenderQueue::run, this);
+	}
+
+	void stop()
+	{
+		if (!thread.joinable()) return;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			running = false;
+		}
+		changed.notify_all();
+		thread.join();
+	}
+
+	// 队列中未完成的命令达到maxInFlight时阻塞
+	uint64_t submit(Command command, int maxInFlight)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock, [&]() { return submitted - completed < (uint64_t)std::max(maxInFlight, 1); });
+
+		commands.push_back(command);
+		uint64_t fence = ++submitted;
+
+		lock.unlock();
+		changed.notify_all();
+		return fence;
+	}
+
+	void wait(uint64_t fence)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock, [&]() { return completed >= fence; });
+	}
+
+	void finish()
+	{
+		wait(submittedCount());
+	}
+
+	uint64_t submittedCount()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return submitted;
+	}
+
+	bool started() const { return thread.joinable(); }
+
+private:
+	void run()
+	{
+		while (true)
+		{
+			Command command;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				changed.wait(lock, [&]() { return !commands.empty() || !running; });
+
+				if (commands.empty()) break;
+
+				command = std::move(commands.front());
+				commands.pop_front();
+			}
+
+			command();
+			// 先析构命令再发信号，保证命令持有的帧内存不会在reset之后才释放
+			command = nullptr;
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				completed++;
+			}
+			changed.notify_all();
+		}
+	}
+
+private:
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable changed;
+
+	std::deque<Command> commands;
+	uint64_t submitted = 0;
+	uint64_t completed = 0;
+	bool running = false;
+};
+
+#endif
@@ -1,51 +1,345 @@
 #ifndef RENDERER_H
 #define RENDERER_H
 
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <thread>
+
 #include "VertexProcessor.h"
 #include "Rasterizer.h"
 #include "FragmentProcessor.h"
 #include "FrameBufferAdapter.h"
 #include "PipelineData.h"
+#include "Arena.h"
+#include "RenderQueue.h"
+#include "OcclusionQuery.h"
+#include "Scene.h"
+
+const int RENDERER_FRAME_ARENAS = 2;
+const int RENDERER_RESOLVE_TILE_SIZE = 32;
 
 struct Renderer
 {
-	template<typename Shader>
+	// indices不为空时按索引取顶点，每3个索引一个三角形
+	template<typename Shader, typename VertexArray, typename IndexArray = std::vector<UINT>>
 	void draw(
-			std::vector<typename Shader::VSIn>& vertexArray,
+			VertexArray& vertexArray,
 			Shader& shader,
-			FrameBufferAdapter& adapter)
+			FrameBufferAdapter& adapter,
+			IndexArray *indices = nullptr)
 	{
 		int width, height;
+		if (!viewportSize(adapter, width, height)) return;
+		if (conditionFailed()) return;
 
-		if (adapter.colorAttachments.size() == 0)
+		FrameArena& arena = arenas[frameIndex];
+
+		ArenaVector<Pipeline::FSIn<typename Shader::VSToFS>> vertexOut = VertexProcessor::processVertex(vertexArray, shader, { (float)width, (float)height }, Primitive::TRIANGLE, arena, indices);
+
+		// 深度预pass：只变换位置、不带varying地光栅化一遍写深度，着色pass再以EQUAL测试，每个像素只着色一次
+		ArenaVector<Pipeline::FSIn<Pipeline::NoVaryings>> depthVertices(arena);
+		if (depthPrepass && renderMode < 2)
 		{
-			if (adapter.depthAttachment == nullptr) return;
-			else
+			depthVertices = VertexProcessor::processPosition(vertexArray, shader, { (float)width, (float)height }, arena, indices);
+		}
+
+		submitDraw(shader, adapter, vertexOut, depthVertices);
+	}
+
+	// 实例化绘制：instances的每个元素（Shader::Instance，SimpleShader中为模型矩阵与材质参数）画一份网格，
+	// 着色器需提供setInstance(Instance*, int)。顶点只取一次，各实例的顶点着色并行，
+	// 所有实例的三角形合在一起光栅化、着色，只有一次分箱与一次片元阶段的提交
+	template<typename Shader, typename VertexArray, typename InstanceArray, typename IndexArray = std::vector<UINT>>
+	void drawInstanced(
+			VertexArray& vertexArray,
+			Shader& shader,
+			FrameBufferAdapter& adapter,
+			InstanceArray& instances,
+			IndexArray *indices = nullptr)
+	{
+		int width, height;
+		if (!viewportSize(adapter, width, height)) return;
+		if (instances.size() == 0 || conditionFailed()) return;
+
+		FrameArena& arena = arenas[frameIndex];
+
+		// 实例数据按值保存到片元阶段结束，之后修改instances不影响已提交的draw
+		typedef typename Shader::Instance Instance;
+		auto instanceData = std::make_shared<std::vector<Instance>>(instances.begin(), instances.end());
+		int instanceCount = instanceData->size();
+
+		ArenaVector<typename Shader::VSIn> vertices = VertexProcessor::fetchVertices<typename Shader::VSIn>(vertexArray, arena);
+
+		ArenaVector<Pipeline::FSIn<typename Shader::VSToFS>> vertexOut = VertexProcessor::processInstances(
+			vertices, shader, instanceData->data(), instanceCount, { (float)width, (float)height }, arena, indices);
+
+		ArenaVector<Pipeline::FSIn<Pipeline::NoVaryings>> depthVertices(arena);
+		if (depthPrepass && renderMode < 2)
+		{
+			depthVertices = VertexProcessor::processInstancePositions(
+				vertices, shader, instanceData->data(), instanceCount, { (float)width, (float)height }, arena, indices);
+		}
+
+		Shader fragmentShader = shader;
+		fragmentShader.setInstance(instanceData->data(), -1);
+
+		submitDraw(fragmentShader, adapter, vertexOut, depthVertices, instanceData);
+	}
+
+	// 只写深度的draw：顶点只求sr_Position，光栅化不插值任何varying，不调用片元着色器
+	// 可用于整帧的深度预pass（之后的draw以默认的LEQUAL测试即只着色可见片元）
+	template<typename Shader, typename VertexArray, typename IndexArray = std::vector<UINT>>
+	void drawDepth(
+			VertexArray& vertexArray,
+			Shader& shader,
+			FrameBufferAdapter& adapter,
+			IndexArray *indices = nullptr)
+	{
+		int width, height;
+		if (!viewportSize(adapter, width, height)) return;
+		if (conditionFailed()) return;
+
+		FrameArena& arena = arenas[frameIndex];
+
+		// 片元引用顶点数组中的顶点，两者一起交给后台
+		auto vertices = std::make_shared<ArenaVector<Pipeline::FSIn<Pipeline::NoVaryings>>>(
+			VertexProcessor::processPosition(vertexArray, shader, { (float)width, (float)height }, arena, indices));
+		auto fragments = std::make_shared<ArenaVector<Pipeline::Quad<Pipeline::NoVaryings>>>(
+			Rasterizer::rasterize(*vertices, cullFaceMode, arena));
+
+		std::atomic<uint64_t> *samples = querySamples();
+		submit([vertices, fragments, samples, &adapter]()
+		{
+			FragmentProcessor::processDepth(adapter, *fragments, samples);
+		});
+	}
+
+	// 延迟着色的光照阶段：draw写好G-buffer（adapter的浮点附件）后调用，
+	// 深度缓冲中被覆盖的像素各调用一次shader.processPixel(adapter)，着色次数与重绘无关
+	template<typename Shader>
+	void resolve(Shader& shader, FrameBufferAdapter& adapter)
+	{
+		auto job = std::make_shared<Shader>(shader);
+		submit([this, job, &adapter]() { shadePixels(*job, adapter); });
+	}
+
+	// 可见性缓冲：光栅化只写深度与drawId | 三角形序号（每像素8字节），不插值任何属性；
+	// resolveVisibility时再对每个像素最终可见的三角形重建重心坐标与属性并着色
+	// 需要adapter设置visibilityAttachment，一帧内最多VISIBILITY_MAX_DRAWS次，每次裁剪后最多2^VISIBILITY_TRIANGLE_BITS个三角形
+	template<typename Shader, typename VertexArray, typename IndexArray = std::vector<UINT>>
+	void drawVisibility(
+			VertexArray& vertexArray,
+			Shader& shader,
+			FrameBufferAdapter& adapter,
+			IndexArray *indices = nullptr)
+	{
+		int width, height;
+		if (!viewportSize(adapter, width, height)) return;
+		if (conditionFailed()) return;
+
+		if (visibilityDraws.size() >= VISIBILITY_MAX_DRAWS)
+		{
+			std::cout << "Too many visibility draws in one frame" << std::endl;
+			return;
+		}
+
+		FrameArena& arena = arenas[frameIndex];
+		UINT drawId = visibilityDraws.size();
+
+		auto draw = std::make_shared<VisibilityDraw<Shader>>(shader,
+			VertexProcessor::processVertex(vertexArray, shader, { (float)width, (float)height }, Primitive::TRIANGLE, arena, indices));
+
+		// 三角形序号只占低VISIBILITY_TRIANGLE_BITS位，超出会写进draw序号
+		if (draw->vertexOut.size() / 3 > VISIBILITY_TRIANGLE_MASK + 1)
+		{
+			std::cout << "Too many triangles in one visibility draw" << std::endl;
+			return;
+		}
+
+		auto fragments = std::make_shared<ArenaVector<Pipeline::VisibilityFragment>>(
+			Rasterizer::rasterizeVisibility(draw->vertexOut, cullFaceMode, drawId, arena));
+
+		visibilityDraws.push_back(draw);
+
+		std::atomic<uint64_t> *samples = querySamples();
+		submit([fragments, samples, &adapter]()
+		{
+			uint64_t passed = 0;
+			for (auto& fragment : *fragments)
 			{
-				width = adapter.depthAttachment->width();
-				height = adapter.depthAttachment->height();
+				adapter.x = fragment.x;
+				adapter.y = fragment.y;
+
+				if (fragment.z > adapter.readDepth()) continue;
+
+				adapter.writeDepth(fragment.z);
+				adapter.writeVisibility(fragment.id);
+				passed++;
+			}
+			if (samples != nullptr) samples->fetch_add(passed, std::memory_order_relaxed);
+		});
+	}
+
+	// 按屏幕分块并行，每个可见像素只重建并着色一次，调用对应draw着色器的processFragment
+	void resolveVisibility(FrameBufferAdapter& adapter)
+	{
+		auto draws = std::make_shared<std::vector<std::shared_ptr<VisibilityDrawBase>>>(std::move(visibilityDraws));
+		visibilityDraws.clear();
+
+		submit([draws, &adapter]()
+		{
+			forEachPixel(adapter, [&](FrameBufferAdapter& local)
+			{
+				UINT id = local.readVisibility();
+				if (id == VISIBILITY_EMPTY) return;
+
+				(*draws)[id >> VISIBILITY_TRIANGLE_BITS]->shade(local, id & VISIBILITY_TRIANGLE_MASK);
+			});
+		});
+	}
+
+	// 遮挡查询：之后提交的draw把通过深度测试的片元数计入query，直到endQuery；查询不能嵌套
+	void beginQuery(OcclusionQuery& query)
+	{
+		activeQuery = &query;
+
+		OcclusionQuery *target = &query;
+		submit([target]() { target->samples.store(0, std::memory_order_relaxed); });
+	}
+
+	// 结果随命令顺序在片元阶段之后写入query，pipelineDepth为0时返回即可读取
+	void endQuery()
+	{
+		if (activeQuery == nullptr) return;
+
+		OcclusionQuery *target = activeQuery;
+		activeQuery = nullptr;
+
+		submit([target]()
+		{
+			target->completed.store(target->samples.load(std::memory_order_relaxed), std::memory_order_release);
+			target->ready.store(true, std::memory_order_release);
+		});
+	}
+
+	// 条件渲染：query最近完成的一轮结果为0时，之后的draw在提交时直接跳过，顶点处理也不做，
+	// 直到endConditionalRender；结果通常来自上一帧，物体重新露出时会晚一帧出现
+	void beginConditionalRender(OcclusionQuery& query)
+	{
+		condition = &query;
+	}
+
+	void endConditionalRender()
+	{
+		condition = nullptr;
+	}
+
+	// 包围盒代理draw：只做深度测试，不写深度与颜色，放在beginQuery与endQuery之间得到盒子露出的片元数，
+	// 为0时盒内的物体被完全挡住；不剔除背面，盒子跨过近平面（相机可能在盒内）时不光栅化，直接计为可见
+	void drawBoundingBox(Bounds& bounds, Mat4 viewProj, FrameBufferAdapter& adapter)
+	{
+		int width, height;
+		if (!viewportSize(adapter, width, height)) return;
+		if (bounds.empty()) return;
+
+		std::atomic<uint64_t> *samples = querySamples();
+
+		std::vector<Vec3> corners(8);
+		for (int corner = 0; corner < 8; corner++)
+		{
+			corners[corner] =
+			{
+				(corner & 1) ? bounds.hi[0] : bounds.lo[0],
+				(corner & 2) ? bounds.hi[1] : bounds.lo[1],
+				(corner & 4) ? bounds.hi[2] : bounds.lo[2]
+			};
+
+			Vec4 pos = { corners[corner][0], corners[corner][1], corners[corner][2], 1.0f };
+			Vec4 clip = viewProj * pos;
+			if (clip[3] <= 0.0f || clip[2] < 0.0f)
+			{
+				if (samples != nullptr) submit([samples]() { samples->fetch_add(1, std::memory_order_relaxed); });
+				return;
 			}
 		}
-		else
+
+		static std::vector<UINT> faces =
 		{
-			width = adapter.colorAttachments[0]->width();
-			height = adapter.colorAttachments[0]->height();
+			0, 2, 3, 0, 3, 1,	4, 5, 7, 4, 7, 6,
+			0, 1, 5, 0, 5, 4,	2, 6, 7, 2, 7, 3,
+			0, 4, 6, 0, 6, 2,	1, 3, 7, 1, 7, 5
+		};
+
+		FrameArena& arena = arenas[frameIndex];
+		BoundsShader shader{ viewProj };
+
+		auto vertices = std::make_shared<ArenaVector<Pipeline::FSIn<Pipeline::NoVaryings>>>(
+			VertexProcessor::processVertex(corners, shader, { (float)width, (float)height }, Primitive::TRIANGLE, arena, &faces));
+		auto fragments = std::make_shared<ArenaVector<Pipeline::Quad<Pipeline::NoVaryings>>>(
+			Rasterizer::rasterize(*vertices, CULL_NONE, arena));
+
+		submit([vertices, fragments, samples, &adapter]()
+		{
+			adapter.depthMask = false;
+			FragmentProcessor::processDepth(adapter, *fragments, samples);
+			adapter.depthMask = true;
+		});
+	}
+
+	// 需要与draw保持顺序的帧操作（清屏、交换缓冲等）都经过这里，非流水线模式下立即执行
+	void submit(std::function<void()> command)
+	{
+		if (pipelineDepth <= 0)
+		{
+			finish();
+			command();
+			return;
 		}
 
-		std::vector<Pipeline::FSIn<SimpleShader::VSToFS>> vertexOut = VertexProcessor::processVertex(vertexArray, shader, { (float)width, (float)height }, Primitive::TRIANGLE);
+		queue.start();
+		queue.submit(command, pipelineDepth);
+	}
+
+	void clear(FrameBufferAdapter& adapter, RGB24 color, float depth)
+	{
+		submit([&adapter, color, depth]() { adapter.clear(color, depth); });
+	}
+
+	void swapBuffers(FrameBufferAdapter& adapter)
+	{
+		submit([&adapter]() { adapter.swapBuffers(); });
+	}
 
-		if (renderMode < 2)
+	// 等待已提交的命令全部执行完
+	void finish()
+	{
+		if (queue.started()) queue.finish();
+	}
+
+	// 一帧的所有draw提交后调用，释放本帧的管线中间数据
+	// 流水线模式下各帧轮流使用arenas，只等待上一次使用同一块arena的帧完成，本帧的片元阶段可与下一帧的顶点阶段重叠
+	void endFrame()
+	{
+		// 未resolve的可见性draw引用本帧的内存，随帧丢弃
+		visibilityDraws.clear();
+
+		if (!queue.started())
 		{
-			std::vector<Pipeline::FSIn<typename Shader::VSToFS>> fragments = Rasterizer::rasterize(vertexOut, cullFaceMode);
-			FragmentProcessor::processFragment(adapter, shader, fragments);
+			arenas[frameIndex].reset();
+			return;
 		}
 
-		if (renderMode != 0) drawFrame(vertexOut, adapter);
+		frameFences[frameIndex] = queue.submittedCount();
+		frameIndex = (frameIndex + 1) % RENDERER_FRAME_ARENAS;
+
+		queue.wait(frameFences[frameIndex]);
+		arenas[frameIndex].reset();
 	}
 
 	template<typename VertexData>
 	void drawFrame(
-			std::vector<VertexData>& vertexData,
+			ArenaVector<VertexData>& vertexData,
 			FrameBufferAdapter& adapter)
 	{
 		for (int i = 0; i < vertexData.size() / 3; i++)
@@ -115,6 +409,237 @@ struct Renderer
 
 	int renderMode = 0;
 	int cullFaceMode = CULL_NONE;
+
+	// 为true时draw先做一遍只写深度的pass，着色pass只处理最终可见的片元
+	bool depthPrepass = false;
+
+	// 同时在途的命令数上限，0为不流水，draw返回时即已画完
+	int pipelineDepth = 0;
+
+private:
+	template<typename Shader>
+	struct DrawJob
+	{
+		Shader shader;
+		ArenaVector<Pipeline::FSIn<typename Shader::VSToFS>> vertexOut;
+		ArenaVector<Pipeline::Quad<typename Shader::VSToFS>> fragments;
+		// depthFragments中的片元引用depthVertices里的顶点，两者一起保留
+		ArenaVector<Pipeline::FSIn<Pipeline::NoVaryings>> depthVertices;
+		ArenaVector<Pipeline::Quad<Pipeline::NoVaryings>> depthFragments;
+	};
+
+	// draw与drawInstanced共用的后半段：光栅化顶点阶段的输出，片元阶段立即执行或交给后台线程
+	// keepAlive为片元阶段仍要引用的其他数据，与提交的命令一起保留
+	template<typename Shader>
+	void submitDraw(
+			Shader& shader,
+			FrameBufferAdapter& adapter,
+			ArenaVector<Pipeline::FSIn<typename Shader::VSToFS>>& vertexOut,
+			ArenaVector<Pipeline::FSIn<Pipeline::NoVaryings>>& depthVertices,
+			std::shared_ptr<void> keepAlive = nullptr)
+	{
+		FrameArena& arena = arenas[frameIndex];
+
+		ArenaVector<Pipeline::Quad<typename Shader::VSToFS>> fragments = (renderMode < 2) ?
+			Rasterizer::rasterize(vertexOut, cullFaceMode, arena) :
+			ArenaVector<Pipeline::Quad<typename Shader::VSToFS>>(arena);
+
+		ArenaVector<Pipeline::Quad<Pipeline::NoVaryings>> depthFragments(arena);
+		if (!depthVertices.empty()) depthFragments = Rasterizer::rasterize(depthVertices, cullFaceMode, arena);
+
+		int mode = renderMode;
+		std::atomic<uint64_t> *samples = querySamples();
+
+		if (pipelineDepth <= 0)
+		{
+			finish();
+			shade(shader, adapter, vertexOut, fragments, depthFragments, mode, samples);
+			return;
+		}
+
+		// 流水线模式：片元阶段交给后台线程，着色器按值拷贝，之后修改uniform不影响已提交的draw
+		auto job = std::make_shared<DrawJob<Shader>>(DrawJob<Shader>
+		{
+			shader, std::move(vertexOut), std::move(fragments), std::move(depthVertices), std::move(depthFragments)
+		});
+
+		queue.start();
+		queue.submit([this, job, keepAlive, &adapter, mode, samples]()
+		{
+			shade(job->shader, adapter, job->vertexOut, job->fragments, job->depthFragments, mode, samples);
+		}, pipelineDepth);
+	}
+
+	template<typename Shader>
+	void shade(
+			Shader& shader,
+			FrameBufferAdapter& adapter,
+			ArenaVector<Pipeline::FSIn<typename Shader::VSToFS>>& vertexOut,
+			ArenaVector<Pipeline::Quad<typename Shader::VSToFS>>& fragments,
+			ArenaVector<Pipeline::Quad<Pipeline::NoVaryings>>& depthFragments,
+			int mode,
+			std::atomic<uint64_t> *samples)
+	{
+		bool prepass = !depthFragments.empty();
+
+		// 查询只统计着色pass，预pass写深度的片元不重复计数
+		if (prepass) FragmentProcessor::processDepth(adapter, depthFragments);
+		if (mode < 2) FragmentProcessor::processFragment(adapter, shader, fragments, prepass ? DEPTH_EQUAL : DEPTH_LEQUAL, samples);
+		if (mode != 0) drawFrame(vertexOut, adapter);
+	}
+
+	struct VisibilityDrawBase
+	{
+		virtual ~VisibilityDrawBase() {}
+		virtual void shade(FrameBufferAdapter& adapter, UINT triangle) = 0;
+	};
+
+	// 保留着色器副本与裁剪后的顶点，直到resolve
+	template<typename Shader>
+	struct VisibilityDraw : VisibilityDrawBase
+	{
+		typedef Pipeline::FSIn<typename Shader::VSToFS> VertexData;
+
+		VisibilityDraw(Shader& shader, ArenaVector<VertexData>&& vertexOut):
+			shader(shader), vertexOut(std::move(vertexOut)) {}
+
+		// 与光栅化相同的顶点顺序与重心坐标，重建出的片元与前向路径一致，偏导走解析求法
+		void shade(FrameBufferAdapter& adapter, UINT triangle)
+		{
+			VertexData* sorted[] = { &vertexOut[triangle * 3 + 0], &vertexOut[triangle * 3 + 1], &vertexOut[triangle * 3 + 2] };
+			Rasterizer::sortVertices(sorted);
+
+			Vec2 va = { (float)sorted[0]->x, (float)sorted[0]->y };
+			Vec2 vb = { (float)sorted[1]->x, (float)sorted[1]->y };
+			Vec2 vc = { (float)sorted[2]->x, (float)sorted[2]->y };
+			Vec2 p = { (float)adapter.x, (float)adapter.y };
+
+			VertexData fragment(*sorted[0], *sorted[1], *sorted[2], Rasterizer::getWeight(va, vb, vc, p));
+			fragment.x = adapter.x;
+			fragment.y = adapter.y;
+
+			shader.processFragment(adapter, fragment);
+		}
+
+		Shader shader;
+		ArenaVector<VertexData> vertexOut;
+	};
+
+	// 包围盒代理draw的顶点着色器，顶点即世界坐标
+	struct BoundsShader
+	{
+		typedef Vec3 VSIn;
+		typedef Pipeline::NoVaryings VSToFS;
+
+		Pipeline::VSOut<VSToFS> processVertex(VSIn& in)
+		{
+			Pipeline::VSOut<VSToFS> out;
+			Vec4 pos = { in[0], in[1], in[2], 1.0f };
+			out.sr_Position = viewProj * pos;
+			return out;
+		}
+
+		Mat4 viewProj;
+	};
+
+	std::atomic<uint64_t>* querySamples()
+	{
+		return (activeQuery != nullptr) ? &activeQuery->samples : nullptr;
+	}
+
+	bool conditionFailed()
+	{
+		return condition != nullptr && condition->occluded();
+	}
+
+	static bool viewportSize(FrameBufferAdapter& adapter, int& width, int& height)
+	{
+		if (adapter.colorAttachments.size() == 0)
+		{
+			if (adapter.depthAttachment == nullptr) return false;
+			else
+			{
+				width = adapter.depthAttachment->width();
+				height = adapter.depthAttachment->height();
+			}
+		}
+		else
+		{
+			width = adapter.colorAttachments[0]->width();
+			height = adapter.colorAttachments[0]->height();
+		}
+		return true;
+	}
+
+	template<typename Shader>
+	static void shadePixels(Shader& shader, FrameBufferAdapter& adapter)
+	{
+		forEachPixel(adapter, [&](FrameBufferAdapter& local)
+		{
+			if (local.covered()) shader.processPixel(local);
+		});
+	}
+
+	// 屏幕分成RENDERER_RESOLVE_TILE_SIZE见方的块，各线程轮流领取；深度已定，不再写深度
+	template<typename Func>
+	static void forEachPixel(FrameBufferAdapter& adapter, Func func)
+	{
+		if (adapter.depthAttachment == nullptr) return;
+
+		int width = adapter.depthAttachment->width();
+		int height = adapter.depthAttachment->height();
+
+		int tilesX = (width + RENDERER_RESOLVE_TILE_SIZE - 1) / RENDERER_RESOLVE_TILE_SIZE;
+		int tilesY = (height + RENDERER_RESOLVE_TILE_SIZE - 1) / RENDERER_RESOLVE_TILE_SIZE;
+		std::atomic<int> nextTile(0);
+
+		const int maxThreads = std::thread::hardware_concurrency();
+		std::vector<std::thread> threads;
+
+		for (int i = 0; i < maxThreads; i++)
+		{
+			threads.emplace_back([&]()
+			{
+				// x、y是adapter的状态，每个线程用自己的副本
+				FrameBufferAdapter local = adapter;
+				local.depthMask = false;
+
+				for (int tile = nextTile++; tile < tilesX * tilesY; tile = nextTile++)
+				{
+					int sx = (tile % tilesX) * RENDERER_RESOLVE_TILE_SIZE;
+					int sy = (tile / tilesX) * RENDERER_RESOLVE_TILE_SIZE;
+					int ex = std::min(sx + RENDERER_RESOLVE_TILE_SIZE, width);
+					int ey = std::min(sy + RENDERER_RESOLVE_TILE_SIZE, height);
+
+					for (int y = sy; y < ey; y++)
+					{
+						for (int x = sx; x < ex; x++)
+						{
+							local.x = x;
+							local.y = y;
+							func(local);
+						}
+					}
+				}
+			});
+		}
+
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+	}
+
+	FrameArena arenas[RENDERER_FRAME_ARENAS];
+	uint64_t frameFences[RENDERER_FRAME_ARENAS] = {};
+	int frameIndex = 0;
+
+	RenderQueue queue;
+
+	std::vector<std::shared_ptr<VisibilityDrawBase>> visibilityDraws;
+
+	OcclusionQuery *activeQuery = nullptr;
+	OcclusionQuery *condition = nullptr;
 };
 
 #endif
@@ -0,0 +1,349 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+#include "math/Vector.h"
+#include "math/Matrix.h"
+
+// BVH叶节点最多容纳的物体数
+const int SCENE_BVH_LEAF_SIZE = 2;
+// 重新拟合后各节点表面积之和超过建树时的这个倍数就整棵重建，物体移动多了树也不至于退化
+const float SCENE_BVH_REBUILD_RATIO = 2.0f;
+
+// 轴对齐包围盒，默认构造的空盒lo大于hi
+struct Bounds
+{
+	Bounds(): lo(FLT_MAX), hi(-FLT_MAX) {}
+	Bounds(Vec3 lo, Vec3 hi): lo(lo), hi(hi) {}
+
+	static Bounds sphere(Vec3 center, float radius)
+	{
+		return Bounds(center - Vec3(radius), center + Vec3(radius));
+	}
+
+	bool empty() { return lo[0] > hi[0]; }
+
+	void expand(Bounds& b)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			lo[i] = std::min(lo[i], b.lo[i]);
+			hi[i] = std::max(hi[i], b.hi[i]);
+		}
+	}
+
+	Vec3 center() { return (lo + hi) * 0.5f; }
+
+	float surfaceArea()
+	{
+		if (empty()) return 0.0f;
+		Vec3 d = hi - lo;
+		return 2.0f * (d[0] * d[1] + d[1] * d[2] + d[2] * d[0]);
+	}
+
+	// 变换后的包围盒：中心直接变换，半边长按矩阵元素的绝对值累加
+	Bounds transformed(Mat4& m)
+	{
+		if (empty()) return *this;
+
+		Vec3 c = center(), e = (hi - lo) * 0.5f;
+		Vec3 mid, extent;
+		for (int i = 0; i < 3; i++)
+		{
+			mid[i] = m(i, 0) * c[0] + m(i, 1) * c[1] + m(i, 2) * c[2] + m(i, 3);
+			extent[i] = std::fabs(m(i, 0)) * e[0] + std::fabs(m(i, 1)) * e[1] + std::fabs(m(i, 2)) * e[2];
+		}
+		return Bounds(mid - extent, mid + extent);
+	}
+
+	Vec3 lo, hi;
+};
+
+enum
+{
+	FRUSTUM_OUTSIDE = 0,
+	FRUSTUM_INTERSECT,
+	FRUSTUM_INSIDE
+} FrustumTest;
+
+// 视锥的六个平面，法线朝内；与裁剪阶段一致，裁剪空间中x、y在[-w, w]内，z在[0, w]内
+struct Frustum
+{
+	Frustum() {}
+	Frustum(Mat4 viewProj)
+	{
+		Vec4 row[4];
+		for (int i = 0; i < 4; i++) row[i] = { viewProj(i, 0), viewProj(i, 1), viewProj(i, 2), viewProj(i, 3) };
+
+		planes[0] = row[2];
+		planes[1] = row[3] - row[2];
+		planes[2] = row[3] + row[0];
+		planes[3] = row[3] - row[0];
+		planes[4] = row[3] + row[1];
+		planes[5] = row[3] - row[1];
+	}
+
+	// 每个平面只检查盒子沿法线方向最远与最近的两个顶点
+	int test(Bounds& b)
+	{
+		int result = FRUSTUM_INSIDE;
+		for (auto& plane : planes)
+		{
+			float farthest = plane[3], nearest = plane[3];
+			for (int i = 0; i < 3; i++)
+			{
+				farthest += plane[i] * (plane[i] >= 0.0f ? b.hi[i] : b.lo[i]);
+				nearest += plane[i] * (plane[i] >= 0.0f ? b.lo[i] : b.hi[i]);
+			}
+			if (farthest < 0.0f) return FRUSTUM_OUTSIDE;
+			if (nearest < 0.0f) result = FRUSTUM_INTERSECT;
+		}
+		return result;
+	}
+
+	Vec4 planes[6];
+};
+
+// 场景：带世界变换的物体（Object由使用者定义，如网格与材质）按世界包围盒组织成BVH
+// 视锥剔除自顶向下遍历，整棵子树在视锥外时一次跳过、完全在视锥内时整段输出不再逐个测试
+// 修改变换只标记物体，下次剔除前沿叶到根重新拟合包围盒，树的质量下降过多时才重建
+template<typename Object>
+class Scene
+{
+public:
+	// 剔除结果的一项，depth为包围盒中心的视空间深度
+	struct Draw
+	{
+		int id;
+		float depth;
+	};
+
+	// localBounds为模型空间的包围盒，返回物体编号
+	int add(Object object, Bounds localBounds, Mat4 transform)
+	{
+		Entry entry;
+		entry.object = object;
+		entry.local = localBounds;
+		entry.transform = transform;
+		entry.world = localBounds.transformed(transform);
+		entries.push_back(entry);
+
+		structureDirty = true;
+		return entries.size() - 1;
+	}
+
+	void setTransform(int id, Mat4 transform)
+	{
+		Entry& entry = entries[id];
+		entry.transform = transform;
+		entry.world = entry.local.transformed(transform);
+		if (structureDirty || entry.dirty) return;
+
+		entry.dirty = true;
+		dirty.push_back(id);
+	}
+
+	Object& object(int id) { return entries[id].object; }
+	Mat4& transform(int id) { return entries[id].transform; }
+	Bounds& bounds(int id) { return entries[id].world; }
+	int size() { return entries.size(); }
+
+	// 有物体加入时重建，否则只重新拟合变换过的物体所在的路径；cull会先调用
+	void update()
+	{
+		if (structureDirty)
+		{
+			build();
+			return;
+		}
+		if (dirty.empty()) return;
+
+		refit();
+		if (treeCost > builtCost * SCENE_BVH_REBUILD_RATIO) build();
+	}
+
+	// 视锥内的物体按深度从近到远写入drawList：不透明物体先画近处的，远处的片元多在深度测试时被拒绝
+	void cull(Mat4 view, Mat4 proj, std::vector<Draw>& drawList)
+	{
+		update();
+		drawList.clear();
+		if (nodes.empty()) return;
+
+		Frustum frustum(proj * view);
+
+		stack.clear();
+		stack.push_back(0);
+		while (!stack.empty())
+		{
+			Node& node = nodes[stack.back()];
+			stack.pop_back();
+
+			int test = frustum.test(node.bounds);
+			if (test == FRUSTUM_OUTSIDE) continue;
+
+			if (test == FRUSTUM_INSIDE || node.left < 0)
+			{
+				for (int i = node.start; i < node.start + node.count; i++)
+				{
+					int id = order[i];
+					if (test == FRUSTUM_INSIDE || frustum.test(entries[id].world) != FRUSTUM_OUTSIDE) drawList.push_back({ id, depth(view, id) });
+				}
+				continue;
+			}
+
+			stack.push_back(node.right);
+			stack.push_back(node.left);
+		}
+
+		std::sort(drawList.begin(), drawList.end(), [](const Draw& a, const Draw& b) { return a.depth < b.depth; });
+	}
+
+private:
+	struct Entry
+	{
+		Object object;
+		Bounds local;
+		Bounds world;
+		Mat4 transform;
+		int leaf = -1;
+		bool dirty = false;
+	};
+
+	// 节点按先序存放，父节点下标总小于子节点；每个节点覆盖order中连续的一段物体
+	struct Node
+	{
+		Bounds bounds;
+		int left = -1, right = -1;
+		int parent = -1;
+		int start = 0, count = 0;
+	};
+
+	// 视空间看向-z，取反后越近越小
+	float depth(Mat4& view, int id)
+	{
+		Vec3 c = entries[id].world.center();
+		return -(view(2, 0) * c[0] + view(2, 1) * c[1] + view(2, 2) * c[2] + view(2, 3));
+	}
+
+	void build()
+	{
+		nodes.clear();
+		order.resize(entries.size());
+		for (int i = 0; i < entries.size(); i++)
+		{
+			order[i] = i;
+			entries[i].dirty = false;
+		}
+		dirty.clear();
+		structureDirty = false;
+
+		treeCost = 0.0f;
+		if (!entries.empty()) buildNode(0, entries.size(), -1);
+		builtCost = treeCost;
+		refitMark.assign(nodes.size(), false);
+	}
+
+	// 按物体中心的包围盒最长轴在中位数处一分为二
+	int buildNode(int start, int count, int parent)
+	{
+		int index = nodes.size();
+		nodes.push_back(Node());
+
+		Bounds bounds, centers;
+		for (int i = start; i < start + count; i++)
+		{
+			Bounds& world = entries[order[i]].world;
+			bounds.expand(world);
+
+			Bounds c(world.center(), world.center());
+			centers.expand(c);
+		}
+
+		nodes[index].bounds = bounds;
+		nodes[index].parent = parent;
+		nodes[index].start = start;
+		nodes[index].count = count;
+		treeCost += bounds.surfaceArea();
+
+		if (count <= SCENE_BVH_LEAF_SIZE)
+		{
+			for (int i = start; i < start + count; i++) entries[order[i]].leaf = index;
+			return index;
+		}
+
+		Vec3 extent = centers.hi - centers.lo;
+		int axis = (extent[0] >= extent[1] && extent[0] >= extent[2]) ? 0 : (extent[1] >= extent[2] ? 1 : 2);
+
+		int half = count / 2;
+		std::nth_element(order.begin() + start, order.begin() + start + half, order.begin() + start + count, [&](int a, int b)
+		{
+			return entries[a].world.center()[axis] < entries[b].world.center()[axis];
+		});
+
+		int left = buildNode(start, half, index);
+		int right = buildNode(start + half, count - half, index);
+		nodes[index].left = left;
+		nodes[index].right = right;
+		return index;
+	}
+
+	// 收集变换过的物体所在叶子及其祖先，按下标从大到小（子节点先于父节点）重算包围盒，
+	// 代价与变换的物体数乘树高成正比
+	void refit()
+	{
+		refitMark.resize(nodes.size(), false);
+		refitNodes.clear();
+		for (int id : dirty)
+		{
+			entries[id].dirty = false;
+			for (int n = entries[id].leaf; n >= 0 && !refitMark[n]; n = nodes[n].parent)
+			{
+				refitMark[n] = true;
+				refitNodes.push_back(n);
+			}
+		}
+		dirty.clear();
+
+		std::sort(refitNodes.begin(), refitNodes.end(), [](int a, int b) { return a > b; });
+
+		for (int n : refitNodes)
+		{
+			Node& node = nodes[n];
+			refitMark[n] = false;
+			treeCost -= node.bounds.surfaceArea();
+
+			Bounds bounds;
+			if (node.left < 0)
+			{
+				for (int i = node.start; i < node.start + node.count; i++) bounds.expand(entries[order[i]].world);
+			}
+			else
+			{
+				bounds.expand(nodes[node.left].bounds);
+				bounds.expand(nodes[node.right].bounds);
+			}
+
+			node.bounds = bounds;
+			treeCost += bounds.surfaceArea();
+		}
+	}
+
+	std::vector<Entry> entries;
+	std::vector<Node> nodes;
+	std::vector<int> order;
+	std::vector<int> dirty;
+	std::vector<int> stack;
+	std::vector<bool> refitMark;
+	std::vector<int> refitNodes;
+	bool structureDirty = false;
+
+	// 各节点包围盒表面积之和，衡量遍历代价
+	float treeCost = 0.0f;
+	float builtCost = 0.0f;
+};
+
+#endif
@@ -6,9 +6,24 @@
 #include "PipelineData.h"
 #include "FrameBufferAdapter.h"
 #include "Texture.h"
+#include "TextureCompressed.h"
+#include "TextureBatch.h"
+#include "LightGrid.h"
+#include "ShadowSampler.h"
+#include "IBL.h"
 
 struct SimpleShader
 {
+	// 延迟着色时G-buffer各浮点附件的内容
+	enum
+	{
+		GBUFFER_POSITION = 0,	// xyz：位置，w：金属度
+		GBUFFER_NORMAL,			// xyz：法线，w：粗糙度
+		GBUFFER_ALBEDO,			// rgb：反照率，w：环境光遮蔽
+		GBUFFER_TEXCOLOR,		// rgba：纹理颜色
+		GBUFFER_COUNT
+	};
+
 	// VS到FS之间传递的数据类型，目前只能做到手动给每一个数据插值
 	struct VSToFS
 	{
@@ -20,6 +35,7 @@ struct SimpleShader
 			pos = lerp(from.pos, to.pos, weight);
 			texCoord = lerp(from.texCoord, to.texCoord, weight);
 			norm = lerp(from.norm, to.norm, weight);
+			instance = from.instance;
 		}
 
 		VSToFS(VSToFS& va, VSToFS& vb, VSToFS& vc, Vec3 weight)
@@ -28,11 +44,14 @@ struct SimpleShader
 			pos = triLerp(va.pos, vb.pos, vc.pos, weight);
 			texCoord = triLerp(va.texCoord, vb.texCoord, vc.texCoord, weight);
 			norm = triLerp(va.norm, vb.norm, vc.norm, weight);
+			instance = va.instance;
 		}
 
 		Vec3 pos;
 		Vec2 texCoord;
 		Vec3 norm;
+		// 所属实例的序号，整个三角形相同，不插值；非实例化绘制为-1
+		int instance = -1;
 	};
 
 	// 输入VS的数据类型
@@ -43,6 +62,24 @@ struct SimpleShader
 		Vec3 norm;
 	};
 
+	// Renderer::drawInstanced的每实例数据，代替对应的uniform
+	struct Instance
+	{
+		Mat4 model = Mat4(1.0f);
+		Vec3 albedo = Vec3(1.0f);
+		float metallic = 1.0f;
+		float roughness = 0.3f;
+	};
+
+	// drawInstanced调用：index >= 0时是该实例顶点阶段的副本，换用实例的模型矩阵并把序号写入varying；
+	// index为-1时是片元阶段的副本，逐片元按varying中的序号从instances取材质
+	void setInstance(Instance *instances, int index)
+	{
+		this->instances = instances;
+		instanceIndex = index;
+		if (index >= 0) model = instances[index].model;
+	}
+
 	// Vertex Shader
 	Pipeline::VSOut<VSToFS> processVertex(VSIn& in)
 	{
@@ -59,21 +96,173 @@ struct SimpleShader
 		out.data.pos = { outPos[0], outPos[1], outPos[2] };
 		out.data.texCoord = in.texCoord;
 		out.data.norm = (modelInv * in.norm).normalized();
+		out.data.instance = instanceIndex;
 		return out;
 	}
 
+	// 只写深度的pass使用，须与processVertex中的sr_Position算法一致，深度才能逐位相等
+	Vec4 processPosition(VSIn& in)
+	{
+		Vec4 inPos = { in.pos[0], in.pos[1], in.pos[2], 1.0f };
+		return proj * view * model * inPos;
+	}
+
 	// Fragment Shader
 	void processFragment(FrameBufferAdapter& adapter, Pipeline::FSIn<VSToFS>& in)
 	{
-		Vec3 result(0.0f);
+		Vec2 dUVdx, dUVdy;
+		in.derivatives(&VSToFS::texCoord, dUVdx, dUVdy);
 
-		Vec3 L = (lightPos - in.data.pos).normalized();
-		Vec3 N = in.data.norm;
-		Vec3 V = (viewPos - in.data.pos).normalized();
-		Vec3 H = (V + L).normalized();
+		Vec4 texColor = (compressedTex != nullptr) ?
+			textureGrad(compressedTex, in.data.texCoord, dUVdx, dUVdy, LINEAR_MIPMAP_LINEAR) :
+			textureGrad(tex, in.data.texCoord, dUVdx, dUVdy, LINEAR_MIPMAP_LINEAR);
+		writeSurface(adapter, in, texColor);
+	}
+
+	// 以quad为单位着色，4个lane共用一个mip级别；分块布局的纹理一次批量采样4个lane，
+	// 其余纹理的批量路径只是逐个采样后再量化成8位，直接逐lane走浮点路径
+	void processFragment(FrameBufferAdapter& adapter, Pipeline::Quad<VSToFS>& quad)
+	{
+		Vec2 dUVdx, dUVdy;
+		quad.derivatives(&VSToFS::texCoord, dUVdx, dUVdy);
+
+		Vec4 texColor[4];
+		if (compressedTex == nullptr && tex != nullptr && tex->tiledLayout)
+		{
+			Vec2 uv[4];
+			for (int i = 0; i < 4; i++) uv[i] = quad[i].data.texCoord;
+
+			RGBA32 texels[4];
+			textureGrad4(tex, uv, dUVdx, dUVdy, LINEAR_MIPMAP_LINEAR, texels);
+			for (int i = 0; i < 4; i++) texColor[i] = texels[i].toVec4();
+		}
+		else
+		{
+			for (int i = 0; i < 4; i++)
+			{
+				if (!quad.active(i)) continue;
+				texColor[i] = (compressedTex != nullptr) ?
+					textureGrad(compressedTex, quad[i].data.texCoord, dUVdx, dUVdy, LINEAR_MIPMAP_LINEAR) :
+					textureGrad(tex, quad[i].data.texCoord, dUVdx, dUVdy, LINEAR_MIPMAP_LINEAR);
+			}
+		}
+
+		for (int i = 0; i < 4; i++)
+		{
+			if (!quad.active(i)) continue;
+
+			adapter.x = quad[i].x;
+			adapter.y = quad[i].y;
+			writeSurface(adapter, quad[i], texColor[i]);
+		}
+	}
+
+	// 延迟着色的光照阶段，每个被覆盖的像素调用一次
+	void processPixel(FrameBufferAdapter& adapter)
+	{
+		Vec4 position = adapter.readFloat(GBUFFER_POSITION);
+		Vec4 normal = adapter.readFloat(GBUFFER_NORMAL);
+		Vec4 material = adapter.readFloat(GBUFFER_ALBEDO);
+		Vec4 texColor = adapter.readFloat(GBUFFER_TEXCOLOR);
+
+		Vec3 result = lighting(adapter.x, adapter.y,
+			{ position[0], position[1], position[2] },
+			{ normal[0], normal[1], normal[2] },
+			{ material[0], material[1], material[2] },
+			position[3], normal[3], material[3]);
+
+		adapter.writeColor(0, result * Vec3{ texColor[0], texColor[1], texColor[2] });
+	}
+
+	// 前向模式直接着色，延迟模式把光照所需的数据写入G-buffer
+	void writeSurface(FrameBufferAdapter& adapter, Pipeline::FSIn<VSToFS>& in, Vec4& texColor)
+	{
+		Vec3 albedo = this->albedo;
+		float metallic = this->metallic, roughness = this->roughness;
+
+		if (instances != nullptr && in.data.instance >= 0)
+		{
+			Instance& instance = instances[in.data.instance];
+			albedo = instance.albedo;
+			metallic = instance.metallic;
+			roughness = instance.roughness;
+		}
+
+		if (deferred)
+		{
+			Vec3& pos = in.data.pos;
+			Vec3& norm = in.data.norm;
+
+			adapter.writeFloat(GBUFFER_POSITION, { pos[0], pos[1], pos[2], metallic });
+			adapter.writeFloat(GBUFFER_NORMAL, { norm[0], norm[1], norm[2], roughness });
+			adapter.writeFloat(GBUFFER_ALBEDO, { albedo[0], albedo[1], albedo[2], ao });
+			adapter.writeFloat(GBUFFER_TEXCOLOR, texColor);
+		}
+		else
+		{
+			Vec3 addition = { texColor[0], texColor[1], texColor[2] };
+			adapter.writeColor(0, lighting(in.x, in.y, in.data.pos, in.data.norm, albedo, metallic, roughness, ao) * addition);
+		}
+
+		adapter.writeDepth(in.z);
+	}
 
+	// x、y为片元的屏幕坐标，设置了lightGrid时用来找所在块的光源列表
+	Vec3 lighting(int x, int y, Vec3 pos, Vec3 N, Vec3 albedo, float metallic, float roughness, float ao)
+	{
+		Vec3 V = (viewPos - pos).normalized();
 		Vec3 F0 = lerp(Vec3(0.04f), albedo, metallic);
 
+		Vec3 Lo = pointLight(pos, N, V, F0, albedo, metallic, roughness, lightPos, lightColor * lightStrength, 0.0f);
+
+		// 背光的片元本来就不受主光源照射，不必采样阴影贴图
+		if (shadow.map != nullptr && dot(N, lightPos - pos) > 0.0f) Lo = Lo * shadow.visibility(pos);
+
+		if (lightGrid != nullptr)
+		{
+			int count;
+			const int *indices = lightGrid->tileLights(x, y, count);
+
+			for (int i = 0; i < count; i++)
+			{
+				PointLight& light = lightGrid->lights[indices[i]];
+				Lo += pointLight(pos, N, V, F0, albedo, metallic, roughness, light.pos, light.color, light.radius);
+			}
+		}
+
+		Lo += ambient(N, V, F0, albedo, metallic, roughness) * ao;
+
+		float GAMMA = 2.2f;
+		return pow(Lo, 1.0f / GAMMA);
+	}
+
+	// 设置了ibl时环境光由预计算的三张表得到：漫反射查irradiance，镜面按split-sum查预滤波图与BRDF表
+	Vec3 ambient(Vec3& N, Vec3& V, Vec3& F0, Vec3& albedo, float metallic, float roughness)
+	{
+		if (ibl == nullptr) return Vec3(0.03f) * albedo;
+
+		float NdotV = std::max(dot(N, V), 0.0f);
+		Vec3 F = fresnelSchlickRoughness(NdotV, F0, roughness);
+
+		Vec3 kD = (Vec3(1.0f) - F) * (1.0f - metallic);
+		Vec3 diffuse = ibl->irradiance(N) * albedo;
+
+		Vec3 R = N * (2.0f * dot(N, V)) - V;
+		Vec2 envBRDF = ibl->brdf(NdotV, roughness);
+		Vec3 specular = ibl->specular(R, roughness) * (F * envBRDF[0] + Vec3(envBRDF[1]));
+
+		return kD * diffuse + specular;
+	}
+
+	// radius大于0时在半径处平滑衰减到0，与光源剔除的范围一致
+	Vec3 pointLight(Vec3& pos, Vec3& N, Vec3& V, Vec3& F0, Vec3& albedo, float metallic, float roughness, Vec3 position, Vec3 intensity, float radius)
+	{
+		float dist = (position - pos).length();
+		if (radius > 0.0f && dist >= radius) return Vec3(0.0f);
+
+		Vec3 L = (position - pos).normalized();
+		Vec3 H = (V + L).normalized();
+
 		Vec3 F = fresnelSchlick(std::max(dot(V, H), 0.0f), F0);
 		float NDF = DistributionGGX(N, H, roughness);
 		float G = GeometrySmith(N, V, L, roughness);
@@ -86,24 +275,16 @@ struct SimpleShader
 		float denominator = 4.0f * std::max(dot(N, V), 0.0f) * std::max(dot(N, L), 0.0f) + 0.001f;
 		Vec3 specular = nominator / denominator;
 
-		float dist = (lightPos - in.data.pos).length();
 		float attenuation = 1.0f / (dist * dist);
-		Vec3 radiance = lightColor * lightStrength * attenuation;
+		if (radius > 0.0f)
+		{
+			float falloff = 1.0f - pow(dist / radius, 4.0f);
+			attenuation *= falloff * falloff;
+		}
+		Vec3 radiance = intensity * attenuation;
 
 		float NdotL = std::max(dot(N, L), 0.0f);
-		Vec3 Lo = ((kD * albedo) / Pi + specular) * radiance * NdotL;
-		Lo += Vec3(0.03f) * albedo * ao;
-
-		float GAMMA = 2.2f;
-		result = pow(Lo, 1.0f / GAMMA);
-
-		Vec4 texColor = texture(tex, in.data.texCoord, LINEAR);
-		Vec3 addition = { texColor[0], texColor[1], texColor[2] };
-
-		result *= addition;
-
-		adapter.writeColor(0, result);
-		adapter.writeDepth(in.z);
+		return ((kD * albedo) / Pi + specular) * radiance * NdotL;
 	}
 
 	Vec3 fresnelSchlick(float cosTheta, Vec3& F0)
@@ -111,6 +292,13 @@ struct SimpleShader
 		return F0 + (Vec3(1.0f) - F0) * pow(1.0f - cosTheta, 5.0f);
 	}
 
+	// 环境光没有单一的半角向量，粗糙表面的掠射角反射率不应趋于1
+	Vec3 fresnelSchlickRoughness(float cosTheta, Vec3& F0, float roughness)
+	{
+		Vec3 Fmax = { std::max(1.0f - roughness, F0[0]), std::max(1.0f - roughness, F0[1]), std::max(1.0f - roughness, F0[2]) };
+		return F0 + (Fmax - F0) * pow(1.0f - cosTheta, 5.0f);
+	}
+
 	float DistributionGGX(Vec3& N, Vec3& H, float roughness)
 	{
 		float a = roughness * roughness;
@@ -161,8 +349,25 @@ struct SimpleShader
 	Vec3 lightPos;
 	Vec3 lightColor;
 
+	// 附加的点光源，逐片元只计算所在屏幕块内的光源
+	LightGrid *lightGrid = nullptr;
+
+	// 主光源的阴影，未设置阴影贴图时不产生阴影
+	ShadowSampler shadow;
+
 	TextureRGB24 *tex = nullptr;
 	TextureRGB24 *env = nullptr;
+	// 由env预计算的环境光照，未设置时环境光为常量
+	IBL *ibl = nullptr;
+	// 设置后代替tex采样
+	TextureBC1 *compressedTex = nullptr;
+
+	// 实例化绘制时由setInstance设置，instances指向本次draw的实例数据
+	Instance *instances = nullptr;
+	int instanceIndex = -1;
+
+	// 为true时processFragment只写G-buffer，光照由Renderer::resolve调用processPixel完成
+	bool deferred = false;
 };
 
 #endif
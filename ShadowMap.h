@@ -0,0 +1,85 @@
+#ifndef SHADOWMAP_H
+#define SHADOWMAP_H
+
+#include <vector>
+#include <type_traits>
+
+#include "math/Vector.h"
+#include "math/Matrix.h"
+#include "FrameBufferAdapter.h"
+#include "FrameBufferDouble.h"
+#include "Texture.h"
+#include "ShadowSampler.h"
+#include "Renderer.h"
+
+// 从光源视角渲染的阴影贴图：深度直接写入TextureFloat，没有颜色附件，
+// 经由Renderer::drawDepth只做位置变换、光栅化与深度测试
+// 采样时比较的是光源观察空间中的距离，偏移量以世界单位计，与投影的远近平面无关
+class ShadowMap
+{
+public:
+	void init(int size)
+	{
+		depth.release();
+		depth.init(size, size);
+		target.wrap(&depth);
+		adapter.depthAttachment = &target;
+	}
+
+	void release()
+	{
+		depth.release();
+	}
+
+	// 透视投影的光源，near、far应尽量贴近场景以保证深度精度
+	void setLight(Vec3 pos, Vec3 lookingAt, float fovy, float zNear, float zFar)
+	{
+		Vec3 dir = (lookingAt - pos).normalized();
+		Vec3 up = (std::abs(dir[2]) > 0.99f) ? Vec3{ 0.0f, 1.0f, 0.0f } : Vec3{ 0.0f, 0.0f, 1.0f };
+
+		lightView = lookAt(pos, lookingAt, up);
+		lightProj = perspective(fovy, 1.0f, zNear, zFar);
+		lightViewProj = lightProj * lightView;
+	}
+
+	void clear(Renderer& renderer)
+	{
+		renderer.clear(adapter, { 0, 0, 0 }, 1.0f);
+	}
+
+	// 一次draw写入阴影贴图，与其他draw同序执行；model为该物体的模型矩阵
+	template<typename VertexArray, typename IndexArray = std::vector<UINT>>
+	void render(Renderer& renderer, VertexArray& vertexArray, Mat4 model, IndexArray *indices = nullptr)
+	{
+		ShadowShader<typename std::decay<decltype(vertexArray[0])>::type> shader;
+		shader.lightMVP = lightViewProj * model;
+		renderer.drawDepth(vertexArray, shader, adapter, indices);
+	}
+
+	// 供着色器按值保存的采样参数，之后再调用setLight不影响已提交的draw
+	ShadowSampler sampler()
+	{
+		ShadowSampler res;
+		res.map = &depth;
+		res.lightViewProj = lightViewProj;
+		res.lightProj = lightProj;
+		res.bias = bias;
+		return res;
+	}
+
+	// 阴影贴图本身，可直接当作纹理使用
+	TextureFloat depth;
+
+	Mat4 lightView;
+	Mat4 lightProj;
+	Mat4 lightViewProj;
+
+	// 比较前把片元向光源移近的距离（世界单位），用于消除自阴影的条纹
+	float bias = 0.05f;
+
+private:
+	FrameBufferDouble<float> target;
+	FrameBufferAdapter adapter;
+};
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef SHADOWSAMPLER_H
+#define SHADOWSAMPLER_H
+
+#include <cmath>
+#include <algorithm>
+
+#include "math/Vector.h"
+#include "math/Matrix.h"
+#include "PipelineData.h"
+#include "Texture.h"
+
+// 渲染阴影贴图用的顶点着色器：只有一个预先乘好的光源MVP，每个顶点一次矩阵乘法
+template<typename Vertex>
+struct ShadowShader
+{
+	typedef Vertex VSIn;
+	typedef Pipeline::NoVaryings VSToFS;
+
+	Vec4 processPosition(VSIn& in)
+	{
+		Vec4 inPos = { in.pos[0], in.pos[1], in.pos[2], 1.0f };
+		return lightMVP * inPos;
+	}
+
+	Pipeline::VSOut<VSToFS> processVertex(VSIn& in)
+	{
+		Pipeline::VSOut<VSToFS> out;
+		out.sr_Position = processPosition(in);
+		return out;
+	}
+
+	Mat4 lightMVP;
+};
+
+// 阴影贴图的PCF采样，map为空时总是返回1
+struct ShadowSampler
+{
+	// 世界坐标pos处被光源照到的比例（0~1）
+	// 3x3纹素的盒式PCF：取覆盖范围内4x4个纹素的比较结果，边缘一圈按小数部分加权，结果随位置连续变化
+	float visibility(Vec3 pos)
+	{
+		if (map == nullptr) return 1.0f;
+
+		Vec4 worldPos = { pos[0], pos[1], pos[2], 1.0f };
+		Vec4 clip = lightViewProj * worldPos;
+
+		// 在光源后方或投影范围之外视为被照亮
+		if (clip[3] <= 0.0f) return 1.0f;
+
+		float x = (clip[0] / clip[3] + 1.0f) / 2.0f * map->width - 0.5f;
+		float y = (clip[1] / clip[3] + 1.0f) / 2.0f * map->height - 0.5f;
+		if (x < -1.0f || x > map->width || y < -1.0f || y > map->height) return 1.0f;
+
+		// 把片元到光源的距离减去偏移量后换算回NDC深度，之后每个纹素只需一次比较
+		float dist = clip[3] - bias;
+		if (dist <= 0.0f) return 1.0f;
+		float reference = (lightProj(2, 2) * -dist + lightProj(2, 3)) / dist;
+
+		int x0 = (int)std::floor(x) - 1;
+		int y0 = (int)std::floor(y) - 1;
+		float fx = x - std::floor(x);
+		float fy = y - std::floor(y);
+
+		float weightX[4] = { 1.0f - fx, 1.0f, 1.0f, fx };
+		float weightY[4] = { 1.0f - fy, 1.0f, 1.0f, fy };
+
+		float lit = 0.0f;
+		for (int j = 0; j < 4; j++)
+		{
+			int ty = std::min(std::max(y0 + j, 0), map->height - 1);
+			// 深度按行翻转存储，与FrameBufferAdapter::writeDepth一致
+			float *row = &(*map)(0, map->height - ty - 1);
+
+			float rowLit = 0.0f;
+			for (int i = 0; i < 4; i++)
+			{
+				int tx = std::min(std::max(x0 + i, 0), map->width - 1);
+				if (reference <= row[tx]) rowLit += weightX[i];
+			}
+			lit += rowLit * weightY[j];
+		}
+
+		return lit / 9.0f;
+	}
+
+	TextureFloat *map = nullptr;
+	Mat4 lightViewProj;
+	Mat4 lightProj;
+	float bias = 0.0f;
+};
+
+#endif
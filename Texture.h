@@ -9,14 +9,168 @@
 #include "Color.h"
 #include "FrameBuffer.h"
 
-typedef FrameBuffer<RGB24> TextureRGB24;
-typedef FrameBuffer<RGBA32> TextureRGBA32;
-typedef FrameBuffer<float> TextureFloat;
+const int TEXTURE_MAX_LEVELS = 16;
+
+inline RGB24 mipAverage(RGB24& a, RGB24& b, RGB24& c, RGB24& d)
+{
+	return RGB24
+	(
+		(a.r + b.r + c.r + d.r + 2) / 4,
+		(a.g + b.g + c.g + d.g + 2) / 4,
+		(a.b + b.b + c.b + d.b + 2) / 4
+	);
+}
+
+inline RGBA32 mipAverage(RGBA32& a, RGBA32& b, RGBA32& c, RGBA32& d)
+{
+	RGBA32 res;
+	res.r = (a.r + b.r + c.r + d.r + 2) / 4;
+	res.g = (a.g + b.g + c.g + d.g + 2) / 4;
+	res.b = (a.b + b.b + c.b + d.b + 2) / 4;
+	res.a = (a.a + b.a + c.a + d.a + 2) / 4;
+	return res;
+}
+
+inline float mipAverage(float& a, float& b, float& c, float& d)
+{
+	return (a + b + c + d) * 0.25f;
+}
+
+// 纹理本身即第0级，其余各级mipmap依次存在mips中
+template<typename T>
+struct Texture2D:
+	FrameBuffer<T>
+{
+	void release()
+	{
+		FrameBuffer<T>::release();
+		for (int i = 0; i < levels - 1; i++) mips[i].release();
+		levels = 1;
+	}
+
+	FrameBuffer<T>& level(int index)
+	{
+		return index == 0 ? *this : mips[index - 1];
+	}
+
+	// 2x2盒式滤波逐级缩小直到1x1，奇数边长时最后一行/列重复使用
+	void generateMipmaps()
+	{
+		for (int i = 0; i < levels - 1; i++) mips[i].release();
+		levels = 1;
+
+		while (levels < TEXTURE_MAX_LEVELS)
+		{
+			FrameBuffer<T>& src = level(levels - 1);
+			if (src.width == 1 && src.height == 1) break;
+
+			FrameBuffer<T>& dst = mips[levels - 1];
+			dst.init(std::max(src.width / 2, 1), std::max(src.height / 2, 1));
+
+			for (int j = 0; j < dst.height; j++)
+			{
+				int j0 = std::min(j * 2, src.height - 1);
+				int j1 = std::min(j * 2 + 1, src.height - 1);
+
+				for (int i = 0; i < dst.width; i++)
+				{
+					int i0 = std::min(i * 2, src.width - 1);
+					int i1 = std::min(i * 2 + 1, src.width - 1);
+
+					dst(i, j) = mipAverage(src(i0, j0), src(i1, j0), src(i0, j1), src(i1, j1));
+				}
+			}
+			levels++;
+		}
+	}
+
+	FrameBuffer<T> mips[TEXTURE_MAX_LEVELS - 1];
+	int levels = 1;
+};
+
+// 4x4块交错存储的一级纹理：块内16个纹素补齐为RGBA32，共64字节正好一条缓存行，
+// 双线性采样的4个纹素大多落在同一块内；边长须为2的幂，环绕寻址用掩码代替取模
+struct TiledLevel
+{
+	struct alignas(64) Block
+	{
+		RGBA32 texels[16];
+	};
+
+	void init(FrameBuffer<RGB24>& src)
+	{
+		width = src.width, height = src.height;
+		widthMask = width - 1, heightMask = height - 1;
+		blocksPerRow = (width + 3) / 4;
+
+		blocks.release();
+		blocks.init(blocksPerRow * ((height + 3) / 4));
+
+		for (int j = 0; j < height; j++)
+		{
+			for (int i = 0; i < width; i++)
+			{
+				RGB24& c = src(i, j);
+				RGBA32& t = texel(i, j);
+				t.r = c.r, t.g = c.g, t.b = c.b, t.a = 255;
+			}
+		}
+	}
+
+	void release()
+	{
+		blocks.release();
+		width = height = 0;
+	}
+
+	RGBA32& texel(int u, int v)
+	{
+		return blocks[(v >> 2) * blocksPerRow + (u >> 2)].texels[((v & 3) << 2) | (u & 3)];
+	}
+
+	Buffer<Block> blocks;
+	int width = 0;
+	int height = 0;
+	int widthMask = 0;
+	int heightMask = 0;
+	int blocksPerRow = 0;
+};
+
+struct TextureRGB24:
+	Texture2D<RGB24>
+{
+	void release()
+	{
+		Texture2D<RGB24>::release();
+		for (auto& level : tiled) level.release();
+		tiledLayout = false;
+	}
+
+	// 按当前的mipmap链生成分块存储，之后采样只读分块数据；非2的幂尺寸保持行主序
+	bool buildTiled()
+	{
+		if ((width & (width - 1)) != 0 || (height & (height - 1)) != 0) return false;
+
+		for (int i = 0; i < levels; i++) tiled[i].init(level(i));
+		tiledLayout = true;
+		return true;
+	}
+
+	TiledLevel tiled[TEXTURE_MAX_LEVELS];
+	bool tiledLayout = false;
+};
+
+typedef Texture2D<RGBA32> TextureRGBA32;
+typedef Texture2D<float> TextureFloat;
 
 enum
 {
 	LINEAR = 0,
-	NEAREST
+	NEAREST,
+	NEAREST_MIPMAP_NEAREST,
+	LINEAR_MIPMAP_NEAREST,
+	NEAREST_MIPMAP_LINEAR,
+	LINEAR_MIPMAP_LINEAR
 } TextureFilterType;
 
 namespace Texture
@@ -37,7 +191,7 @@ namespace Texture
 		return data;
 	}
 
-	void load(TextureRGB24& tex, const char *filePath)
+	void load(TextureRGB24& tex, const char *filePath, bool tiled = false)
 	{
 		int width, height;
 		BYTE *data = loadTexture(filePath, 3, width, height);
@@ -46,6 +200,13 @@ namespace Texture
 
 		memcpy(tex.ptr(), data, width * height * sizeof(RGB24));
 		stbi_image_free(data);
+
+		tex.generateMipmaps();
+
+		if (tiled && !tex.buildTiled())
+		{
+			std::cout << "Texture size not power of two, keeping linear layout" << std::endl;
+		}
 	}
 
 	/*TextureRGBA32 loadRGBA32(const char *filePath)
@@ -63,23 +224,19 @@ namespace Texture
 	}*/
 }
 
-inline Vec4 texture(TextureRGB24* tex, Vec2 uv, int filterType)
+inline Vec4 sampleLevel(FrameBuffer<RGB24>* tex, Vec2 uv, bool linear)
 {
-	if (tex == nullptr) return Vec4(0.0f);
-
-	Vec4 res(1.0f);
-
 	float x = (tex->width - 1) * uv[0];
 	float y = (tex->height - 1) * uv[1];
 
-	if (filterType == NEAREST)
+	if (!linear)
 	{
 		int u = (int)(x - 0.5f + tex->width) % tex->width;
 		int v = (int)(y - 0.5f + tex->height) % tex->height;
 
 		return (*tex)(u, v).toVec4();
 	}
-	else if (filterType == LINEAR)
+	else
 	{
 		int u1 = (int)(x + tex->width) % tex->width;
 		int v1 = (int)(y + tex->height) % tex->height;
@@ -98,4 +255,89 @@ inline Vec4 texture(TextureRGB24* tex, Vec2 uv, int filterType)
 	}
 }
 
+inline Vec4 sampleLevel(TiledLevel* tex, Vec2 uv, bool linear)
+{
+	float x = (tex->width - 1) * uv[0];
+	float y = (tex->height - 1) * uv[1];
+
+	if (!linear)
+	{
+		int u = (int)(x - 0.5f + tex->width) & tex->widthMask;
+		int v = (int)(y - 0.5f + tex->height) & tex->heightMask;
+
+		return tex->texel(u, v).toVec4();
+	}
+
+	int u1 = (int)(x + tex->width) & tex->widthMask;
+	int v1 = (int)(y + tex->height) & tex->heightMask;
+	int u2 = (u1 + 1) & tex->widthMask;
+	int v2 = (v1 + 1) & tex->heightMask;
+
+	Vec4 c1 = tex->texel(u1, v1).toVec4();
+	Vec4 c2 = tex->texel(u2, v1).toVec4();
+	Vec4 c3 = tex->texel(u1, v2).toVec4();
+	Vec4 c4 = tex->texel(u2, v2).toVec4();
+
+	float lx = x - (int)x;
+	float ly = y - (int)y;
+
+	return lerp(lerp(c1, c2, lx), lerp(c3, c4, lx), ly);
+}
+
+inline Vec4 sampleMip(TextureRGB24* tex, int level, Vec2 uv, bool linear)
+{
+	if (tex->tiledLayout) return sampleLevel(&tex->tiled[level], uv, linear);
+	return sampleLevel(&tex->level(level), uv, linear);
+}
+
+// lod为mipmap级别，非mipmap的过滤方式忽略lod只采样第0级
+// Tex为任意提供width、height、levels以及对应sampleMip重载的纹理类型
+template<typename Tex>
+Vec4 textureLod(Tex* tex, Vec2 uv, float lod, int filterType)
+{
+	if (tex == nullptr) return Vec4(0.0f);
+
+	if (filterType == LINEAR || filterType == NEAREST)
+	{
+		return sampleMip(tex, 0, uv, filterType == LINEAR);
+	}
+
+	bool linear = (filterType == LINEAR_MIPMAP_NEAREST || filterType == LINEAR_MIPMAP_LINEAR);
+	float maxLevel = tex->levels - 1;
+	lod = std::min(std::max(lod, 0.0f), maxLevel);
+
+	if (filterType == NEAREST_MIPMAP_NEAREST || filterType == LINEAR_MIPMAP_NEAREST)
+	{
+		return sampleMip(tex, (int)(lod + 0.5f), uv, linear);
+	}
+
+	int base = (int)lod;
+	int next = std::min(base + 1, tex->levels - 1);
+
+	Vec4 c1 = sampleMip(tex, base, uv, linear);
+	if (next == base) return c1;
+
+	Vec4 c2 = sampleMip(tex, next, uv, linear);
+	return lerp(c1, c2, lod - base);
+}
+
+// 由uv的屏幕空间偏导选择级别：一个像素覆盖的纹素数取log2
+template<typename Tex>
+Vec4 textureGrad(Tex* tex, Vec2 uv, Vec2 dUVdx, Vec2 dUVdy, int filterType)
+{
+	if (tex == nullptr) return Vec4(0.0f);
+
+	Vec2 size = { (float)tex->width, (float)tex->height };
+	float rho = std::max((dUVdx * size).length(), (dUVdy * size).length());
+	float lod = rho > 0.0f ? std::log2(rho) : 0.0f;
+
+	return textureLod(tex, uv, lod, filterType);
+}
+
+template<typename Tex>
+Vec4 texture(Tex* tex, Vec2 uv, int filterType)
+{
+	return textureLod(tex, uv, 0.0f, filterType);
+}
+
 #endif
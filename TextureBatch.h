@@ -0,0 +1,220 @@
+#ifndef TEXTUREBATCH_H
+#define TEXTUREBATCH_H
+
+#include <cstring>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TEXTURE_BATCH_SSE2
+#endif
+
+#include "math/Vector.h"
+#include "Color.h"
+#include "Texture.h"
+
+const int TEXTURE_BATCH_SIZE = 4;
+
+// 批量采样：一次处理4个uv（通常是一个2x2 quad），结果为打包的RGBA8
+// 分块存储的纹理走定点快速路径：坐标与权重在SSE寄存器中算出，权重取0~256的8位定点，
+// 4个纹素解包成16位后用乘加完成双线性/三线性混合；行主序纹理逐个回退到标量采样
+
+namespace TextureBatch
+{
+	inline UINT packTexel(RGBA32& c)
+	{
+		UINT res;
+		memcpy(&res, &c, sizeof(res));
+		return res;
+	}
+
+	inline RGBA32 toRGBA32(Vec4 c)
+	{
+		RGBA32 res;
+		res.r = (BYTE)(std::min(std::max(c[0], 0.0f), 1.0f) * 255.0f + 0.5f);
+		res.g = (BYTE)(std::min(std::max(c[1], 0.0f), 1.0f) * 255.0f + 0.5f);
+		res.b = (BYTE)(std::min(std::max(c[2], 0.0f), 1.0f) * 255.0f + 0.5f);
+		res.a = (BYTE)(std::min(std::max(c[3], 0.0f), 1.0f) * 255.0f + 0.5f);
+		return res;
+	}
+
+	// a*(256-w) + b*w 再右移8位，4个纹素各自的权重为w[i]
+	inline void blend4(UINT a[4], UINT b[4], int w[4], UINT out[4])
+	{
+#ifdef TEXTURE_BATCH_SSE2
+		__m128i zero = _mm_setzero_si128();
+		__m128i va = _mm_loadu_si128((__m128i*)a);
+		__m128i vb = _mm_loadu_si128((__m128i*)b);
+
+		__m128i wLo = _mm_set_epi16(w[1], w[1], w[1], w[1], w[0], w[0], w[0], w[0]);
+		__m128i wHi = _mm_set_epi16(w[3], w[3], w[3], w[3], w[2], w[2], w[2], w[2]);
+		__m128i full = _mm_set1_epi16(256);
+
+		__m128i aLo = _mm_unpacklo_epi8(va, zero), aHi = _mm_unpackhi_epi8(va, zero);
+		__m128i bLo = _mm_unpacklo_epi8(vb, zero), bHi = _mm_unpackhi_epi8(vb, zero);
+
+		// 255*256不超过16位无符号范围，mullo的低16位即为结果
+		__m128i lo = _mm_add_epi16(_mm_mullo_epi16(aLo, _mm_sub_epi16(full, wLo)), _mm_mullo_epi16(bLo, wLo));
+		__m128i hi = _mm_add_epi16(_mm_mullo_epi16(aHi, _mm_sub_epi16(full, wHi)), _mm_mullo_epi16(bHi, wHi));
+
+		lo = _mm_srli_epi16(lo, 8);
+		hi = _mm_srli_epi16(hi, 8);
+
+		_mm_storeu_si128((__m128i*)out, _mm_packus_epi16(lo, hi));
+#else
+		for (int i = 0; i < 4; i++)
+		{
+			UINT res = 0;
+			for (int c = 0; c < 4; c++)
+			{
+				UINT ca = (a[i] >> (c * 8)) & 0xff;
+				UINT cb = (b[i] >> (c * 8)) & 0xff;
+				res |= ((ca * (256 - w[i]) + cb * w[i]) >> 8) << (c * 8);
+			}
+			out[i] = res;
+		}
+#endif
+	}
+
+	// 与sampleLevel(TiledLevel*)相同的寻址方式，权重量化为8位定点
+	inline void sampleLevel4(TiledLevel* tex, Vec2 uv[4], bool linear, UINT out[4])
+	{
+		int u1[4], v1[4], fx[4], fy[4];
+
+#ifdef TEXTURE_BATCH_SSE2
+		__m128 us = _mm_set_ps(uv[3][0], uv[2][0], uv[1][0], uv[0][0]);
+		__m128 vs = _mm_set_ps(uv[3][1], uv[2][1], uv[1][1], uv[0][1]);
+
+		__m128 x = _mm_mul_ps(us, _mm_set1_ps((float)(tex->width - 1)));
+		__m128 y = _mm_mul_ps(vs, _mm_set1_ps((float)(tex->height - 1)));
+
+		if (!linear)
+		{
+			x = _mm_sub_ps(x, _mm_set1_ps(0.5f));
+			y = _mm_sub_ps(y, _mm_set1_ps(0.5f));
+		}
+
+		// 加上边长保证截断前为正，与标量版的取整方式一致
+		x = _mm_add_ps(x, _mm_set1_ps((float)tex->width));
+		y = _mm_add_ps(y, _mm_set1_ps((float)tex->height));
+
+		__m128i xi = _mm_cvttps_epi32(x);
+		__m128i yi = _mm_cvttps_epi32(y);
+		__m128i xf = _mm_cvttps_epi32(_mm_mul_ps(_mm_sub_ps(x, _mm_cvtepi32_ps(xi)), _mm_set1_ps(256.0f)));
+		__m128i yf = _mm_cvttps_epi32(_mm_mul_ps(_mm_sub_ps(y, _mm_cvtepi32_ps(yi)), _mm_set1_ps(256.0f)));
+
+		xi = _mm_and_si128(xi, _mm_set1_epi32(tex->widthMask));
+		yi = _mm_and_si128(yi, _mm_set1_epi32(tex->heightMask));
+
+		_mm_storeu_si128((__m128i*)u1, xi);
+		_mm_storeu_si128((__m128i*)v1, yi);
+		_mm_storeu_si128((__m128i*)fx, xf);
+		_mm_storeu_si128((__m128i*)fy, yf);
+#else
+		for (int i = 0; i < 4; i++)
+		{
+			float x = (tex->width - 1) * uv[i][0] + (linear ? 0.0f : -0.5f) + tex->width;
+			float y = (tex->height - 1) * uv[i][1] + (linear ? 0.0f : -0.5f) + tex->height;
+
+			u1[i] = (int)x & tex->widthMask;
+			v1[i] = (int)y & tex->heightMask;
+			fx[i] = (int)((x - (int)x) * 256.0f);
+			fy[i] = (int)((y - (int)y) * 256.0f);
+		}
+#endif
+
+		if (!linear)
+		{
+			for (int i = 0; i < 4; i++) out[i] = packTexel(tex->texel(u1[i], v1[i]));
+			return;
+		}
+
+		UINT c1[4], c2[4], c3[4], c4[4];
+
+		for (int i = 0; i < 4; i++)
+		{
+			int u2 = (u1[i] + 1) & tex->widthMask;
+			int v2 = (v1[i] + 1) & tex->heightMask;
+
+			c1[i] = packTexel(tex->texel(u1[i], v1[i]));
+			c2[i] = packTexel(tex->texel(u2, v1[i]));
+			c3[i] = packTexel(tex->texel(u1[i], v2));
+			c4[i] = packTexel(tex->texel(u2, v2));
+		}
+
+		UINT top[4], bottom[4];
+		blend4(c1, c2, fx, top);
+		blend4(c3, c4, fx, bottom);
+		blend4(top, bottom, fy, out);
+	}
+}
+
+// 4个uv共用一个lod（同一quad），结果按RGBA8打包写入out
+inline void textureLod4(TextureRGB24* tex, Vec2 uv[4], float lod, int filterType, RGBA32 out[4])
+{
+	if (tex == nullptr)
+	{
+		memset(out, 0, sizeof(RGBA32) * 4);
+		return;
+	}
+
+	if (!tex->tiledLayout)
+	{
+		for (int i = 0; i < 4; i++) out[i] = TextureBatch::toRGBA32(textureLod(tex, uv[i], lod, filterType));
+		return;
+	}
+
+	UINT *res = (UINT*)out;
+
+	if (filterType == LINEAR || filterType == NEAREST)
+	{
+		TextureBatch::sampleLevel4(&tex->tiled[0], uv, filterType == LINEAR, res);
+		return;
+	}
+
+	bool linear = (filterType == LINEAR_MIPMAP_NEAREST || filterType == LINEAR_MIPMAP_LINEAR);
+	lod = std::min(std::max(lod, 0.0f), (float)(tex->levels - 1));
+
+	if (filterType == NEAREST_MIPMAP_NEAREST || filterType == LINEAR_MIPMAP_NEAREST)
+	{
+		TextureBatch::sampleLevel4(&tex->tiled[(int)(lod + 0.5f)], uv, linear, res);
+		return;
+	}
+
+	int base = (int)lod;
+	int next = std::min(base + 1, tex->levels - 1);
+
+	TextureBatch::sampleLevel4(&tex->tiled[base], uv, linear, res);
+	if (next == base) return;
+
+	UINT c2[4];
+	TextureBatch::sampleLevel4(&tex->tiled[next], uv, linear, c2);
+
+	int w = (int)((lod - base) * 256.0f);
+	int weights[4] = { w, w, w, w };
+	TextureBatch::blend4(res, c2, weights, res);
+}
+
+// quad内共用一组uv偏导选择级别
+inline void textureGrad4(TextureRGB24* tex, Vec2 uv[4], Vec2 dUVdx, Vec2 dUVdy, int filterType, RGBA32 out[4])
+{
+	float lod = 0.0f;
+
+	if (tex != nullptr)
+	{
+		Vec2 size = { (float)tex->width, (float)tex->height };
+		float rho = std::max((dUVdx * size).length(), (dUVdy * size).length());
+		lod = rho > 0.0f ? std::log2(rho) : 0.0f;
+	}
+
+	textureLod4(tex, uv, lod, filterType, out);
+}
+
+// 8个uv按两批处理
+inline void textureLod8(TextureRGB24* tex, Vec2 uv[8], float lod, int filterType, RGBA32 out[8])
+{
+	textureLod4(tex, uv, lod, filterType, out);
+	textureLod4(tex, uv + 4, lod, filterType, out + 4);
+}
+
+#endif
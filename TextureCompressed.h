@@ -0,0 +1,368 @@
+#ifndef TEXTURECOMPRESSED_H
+#define TEXTURECOMPRESSED_H
+
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+
+#include "math/Vector.h"
+#include "Color.h"
+#include "Buffer.h"
+#include "Texture.h"
+
+const int TEXTURE_BLOCK_CACHE_SIZE = 16;
+
+// BC1：4x4块8字节（每纹素4位），两个RGB565端点加16个2位索引
+struct BC1
+{
+	struct Block
+	{
+		uint16_t c0, c1;
+		uint32_t indices;
+	};
+
+	typedef RGB24 Source;
+	typedef RGBA32 Texel;
+
+	static uint16_t pack565(int r, int g, int b)
+	{
+		return (uint16_t)(((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 | ((b * 31 + 127) / 255));
+	}
+
+	static RGBA32 unpack565(uint16_t c)
+	{
+		int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+
+		RGBA32 res;
+		res.r = (r << 3) | (r >> 2);
+		res.g = (g << 2) | (g >> 4);
+		res.b = (b << 3) | (b >> 2);
+		res.a = 255;
+		return res;
+	}
+
+	static void palette(Block& block, RGBA32 colors[4])
+	{
+		colors[0] = unpack565(block.c0);
+		colors[1] = unpack565(block.c1);
+
+		colors[2].r = (2 * colors[0].r + colors[1].r) / 3;
+		colors[2].g = (2 * colors[0].g + colors[1].g) / 3;
+		colors[2].b = (2 * colors[0].b + colors[1].b) / 3;
+		colors[2].a = 255;
+
+		colors[3].r = (colors[0].r + 2 * colors[1].r) / 3;
+		colors[3].g = (colors[0].g + 2 * colors[1].g) / 3;
+		colors[3].b = (colors[0].b + 2 * colors[1].b) / 3;
+		colors[3].a = 255;
+	}
+
+	// 端点取纹素在包围盒对角线方向上投影的两端，只用c0 > c1的4色模式
+	static Block encode(RGB24 texels[16])
+	{
+		int lo[3] = { 255, 255, 255 }, hi[3] = { 0, 0, 0 };
+		for (int i = 0; i < 16; i++)
+		{
+			int c[3] = { texels[i].r, texels[i].g, texels[i].b };
+			for (int k = 0; k < 3; k++) lo[k] = std::min(lo[k], c[k]), hi[k] = std::max(hi[k], c[k]);
+		}
+
+		int axis[3] = { hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2] };
+		int minIndex = 0, maxIndex = 0, minProj = INT32_MAX, maxProj = INT32_MIN;
+
+		for (int i = 0; i < 16; i++)
+		{
+			int proj = texels[i].r * axis[0] + texels[i].g * axis[1] + texels[i].b * axis[2];
+			if (proj < minProj) minProj = proj, minIndex = i;
+			if (proj > maxProj) maxProj = proj, maxIndex = i;
+		}
+
+		Block block;
+		block.c0 = pack565(texels[maxIndex].r, texels[maxIndex].g, texels[maxIndex].b);
+		block.c1 = pack565(texels[minIndex].r, texels[minIndex].g, texels[minIndex].b);
+		block.indices = 0;
+
+		if (block.c0 == block.c1) return block;
+		if (block.c0 < block.c1) std::swap(block.c0, block.c1);
+
+		RGBA32 colors[4];
+		palette(block, colors);
+
+		for (int i = 0; i < 16; i++)
+		{
+			int best = 0, bestDist = INT32_MAX;
+			for (int j = 0; j < 4; j++)
+			{
+				int dr = texels[i].r - colors[j].r, dg = texels[i].g - colors[j].g, db = texels[i].b - colors[j].b;
+				int dist = dr * dr + dg * dg + db * db;
+				if (dist < bestDist) bestDist = dist, best = j;
+			}
+			block.indices |= (uint32_t)best << (i * 2);
+		}
+
+		return block;
+	}
+
+	static void decode(Block& block, RGBA32 texels[16])
+	{
+		RGBA32 colors[4];
+		palette(block, colors);
+
+		for (int i = 0; i < 16; i++)
+		{
+			texels[i] = colors[(block.indices >> (i * 2)) & 3];
+		}
+	}
+};
+
+struct R8
+{
+	Vec4 toVec4()
+	{
+		return Vec4{ r / 255.0f, 0.0f, 0.0f, 1.0f };
+	}
+
+	BYTE r;
+};
+
+// BC4：单通道，4x4块8字节，两个8位端点加16个3位索引
+struct BC4
+{
+	struct Block
+	{
+		BYTE r0, r1;
+		BYTE indices[6];
+	};
+
+	typedef float Source;
+	typedef R8 Texel;
+
+	static void palette(Block& block, BYTE values[8])
+	{
+		values[0] = block.r0;
+		values[1] = block.r1;
+
+		if (block.r0 > block.r1)
+		{
+			for (int i = 2; i < 8; i++) values[i] = ((8 - i) * block.r0 + (i - 1) * block.r1) / 7;
+		}
+		else
+		{
+			for (int i = 2; i < 6; i++) values[i] = ((6 - i) * block.r0 + (i - 1) * block.r1) / 5;
+			values[6] = 0;
+			values[7] = 255;
+		}
+	}
+
+	static Block encode(float texels[16])
+	{
+		BYTE v[16];
+		BYTE lo = 255, hi = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			v[i] = (BYTE)(std::min(std::max(texels[i], 0.0f), 1.0f) * 255.0f + 0.5f);
+			lo = std::min(lo, v[i]), hi = std::max(hi, v[i]);
+		}
+
+		Block block;
+		block.r0 = hi, block.r1 = lo;
+		memset(block.indices, 0, sizeof(block.indices));
+		if (hi == lo) return block;
+
+		BYTE values[8];
+		palette(block, values);
+
+		uint64_t bits = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			int best = 0, bestDist = 256;
+			for (int j = 0; j < 8; j++)
+			{
+				int dist = std::abs(v[i] - values[j]);
+				if (dist < bestDist) bestDist = dist, best = j;
+			}
+			bits |= (uint64_t)best << (i * 3);
+		}
+
+		for (int i = 0; i < 6; i++) block.indices[i] = (bits >> (i * 8)) & 0xff;
+		return block;
+	}
+
+	static void decode(Block& block, R8 texels[16])
+	{
+		BYTE values[8];
+		palette(block, values);
+
+		uint64_t bits = 0;
+		for (int i = 0; i < 6; i++) bits |= (uint64_t)block.indices[i] << (i * 8);
+
+		for (int i = 0; i < 16; i++)
+		{
+			texels[i].r = values[(bits >> (i * 3)) & 7];
+		}
+	}
+};
+
+// 块压缩纹理，各级mipmap分别压缩；采样时按块解码，
+// 每个线程保留一个小的直接映射缓存，双线性的4个纹素通常只解码一次
+template<typename Format>
+struct TextureCompressed
+{
+	typedef typename Format::Block Block;
+	typedef typename Format::Texel Texel;
+
+	struct Level
+	{
+		Buffer<Block> blocks;
+		int width = 0;
+		int height = 0;
+		int blocksPerRow = 0;
+	};
+
+	void release()
+	{
+		for (int i = 0; i < levels; i++) mips[i].blocks.release();
+		width = height = 0;
+		levels = 0;
+	}
+
+	// 从未压缩纹理压缩全部级别，边长不是4的倍数时用边缘纹素补齐
+	void compress(Texture2D<typename Format::Source>& src)
+	{
+		release();
+		id = nextId()++;
+		width = src.width, height = src.height;
+		levels = src.levels;
+
+		for (int l = 0; l < levels; l++)
+		{
+			FrameBuffer<typename Format::Source>& img = src.level(l);
+			Level& level = mips[l];
+
+			level.width = img.width, level.height = img.height;
+			level.blocksPerRow = (img.width + 3) / 4;
+
+			int blocksPerColumn = (img.height + 3) / 4;
+			level.blocks.init(level.blocksPerRow * blocksPerColumn);
+
+			for (int by = 0; by < blocksPerColumn; by++)
+			{
+				for (int bx = 0; bx < level.blocksPerRow; bx++)
+				{
+					typename Format::Source texels[16];
+					for (int j = 0; j < 4; j++)
+					{
+						for (int i = 0; i < 4; i++)
+						{
+							texels[j * 4 + i] = img(std::min(bx * 4 + i, img.width - 1), std::min(by * 4 + j, img.height - 1));
+						}
+					}
+					level.blocks[by * level.blocksPerRow + bx] = Format::encode(texels);
+				}
+			}
+		}
+	}
+
+	Texel fetch(int level, int u, int v)
+	{
+		Level& mip = mips[level];
+		int blockIndex = (v >> 2) * mip.blocksPerRow + (u >> 2);
+		Block *block = &mip.blocks[blockIndex];
+
+		CacheEntry& entry = cache[((uintptr_t)block / sizeof(Block)) % TEXTURE_BLOCK_CACHE_SIZE];
+		if (entry.block != block || entry.owner != id)
+		{
+			Format::decode(*block, entry.texels);
+			entry.block = block;
+			entry.owner = id;
+		}
+		return entry.texels[((v & 3) << 2) | (u & 3)];
+	}
+
+	size_t byteSize()
+	{
+		size_t size = 0;
+		for (int i = 0; i < levels; i++) size += mips[i].blocks.count * sizeof(Block);
+		return size;
+	}
+
+	Level mips[TEXTURE_MAX_LEVELS];
+	int width = 0;
+	int height = 0;
+	int levels = 0;
+
+private:
+	// 缓存以块地址加纹理编号为键，避免重新压缩后复用同一地址时读到旧数据
+	struct CacheEntry
+	{
+		Block *block = nullptr;
+		uint32_t owner = 0;
+		Texel texels[16];
+	};
+
+	static std::atomic<uint32_t>& nextId()
+	{
+		static std::atomic<uint32_t> counter{ 1 };
+		return counter;
+	}
+
+	uint32_t id = 0;
+
+	static thread_local CacheEntry cache[TEXTURE_BLOCK_CACHE_SIZE];
+};
+
+template<typename Format>
+thread_local typename TextureCompressed<Format>::CacheEntry TextureCompressed<Format>::cache[TEXTURE_BLOCK_CACHE_SIZE];
+
+typedef TextureCompressed<BC1> TextureBC1;
+typedef TextureCompressed<BC4> TextureBC4;
+
+// 与行主序纹理相同的寻址方式，纹素经由块缓存取得
+template<typename Format>
+Vec4 sampleMip(TextureCompressed<Format>* tex, int level, Vec2 uv, bool linear)
+{
+	int width = tex->mips[level].width;
+	int height = tex->mips[level].height;
+
+	float x = (width - 1) * uv[0];
+	float y = (height - 1) * uv[1];
+
+	if (!linear)
+	{
+		int u = (int)(x - 0.5f + width) % width;
+		int v = (int)(y - 0.5f + height) % height;
+
+		return tex->fetch(level, u, v).toVec4();
+	}
+
+	int u1 = (int)(x + width) % width;
+	int v1 = (int)(y + height) % height;
+	int u2 = (int)(x + 1.0f + width) % width;
+	int v2 = (int)(y + 1.0f + height) % height;
+
+	Vec4 c1 = tex->fetch(level, u1, v1).toVec4();
+	Vec4 c2 = tex->fetch(level, u2, v1).toVec4();
+	Vec4 c3 = tex->fetch(level, u1, v2).toVec4();
+	Vec4 c4 = tex->fetch(level, u2, v2).toVec4();
+
+	float lx = x - (int)x;
+	float ly = y - (int)y;
+
+	return lerp(lerp(c1, c2, lx), lerp(c3, c4, lx), ly);
+}
+
+namespace Texture
+{
+	inline void loadCompressed(TextureBC1& tex, const char *filePath)
+	{
+		TextureRGB24 src;
+		load(src, filePath);
+		tex.compress(src);
+
+		std::cout << "Compressed to BC1: " << tex.byteSize() << " bytes" << std::endl;
+	}
+}
+
+#endif
@@ -0,0 +1,202 @@
+#ifndef VERTEXLAYOUT_H
+#define VERTEXLAYOUT_H
+
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define VERTEX_LAYOUT_SSE2
+#endif
+
+#include "Platform.h"
+#include "math/Vector.h"
+
+enum
+{
+	VERTEX_FLOAT = 0,	// 每分量32位浮点
+	VERTEX_UNORM16,		// 每分量16位无符号定点，解码为 offset + q * scale
+	VERTEX_OCT16		// 单位向量的八面体编码，两个16位有符号定点，解码为Vec3
+} VertexFormat;
+
+// 一个属性在原始内存中的位置：第i个顶点的数据位于 data + i * stride，
+// 解码后写入Vertex中偏移为target的Vec<components>
+struct VertexAttribute
+{
+	const BYTE *data = nullptr;
+	size_t stride = 0;
+	int format = VERTEX_FLOAT;
+	int components = 0;
+	size_t target = 0;
+	// VERTEX_UNORM16的反量化参数，每个分量一组
+	float scale[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	float offset[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+};
+
+// 把v量化到[lo, lo + range]内的16位定点，range为0时取0
+inline uint16_t encodeUnorm16(float v, float lo, float range)
+{
+	if (range <= 0.0f) return 0;
+	float q = (v - lo) / range * 65535.0f + 0.5f;
+	return (uint16_t)std::fmin(std::fmax(q, 0.0f), 65535.0f);
+}
+
+// 单位向量投影到八面体|x|+|y|+|z|=1上，下半球沿对角线折到上半球，得到[-1,1]^2内的两个分量
+inline void encodeOctahedral(Vec3& n, int16_t out[2])
+{
+	float l1 = std::fabs(n[0]) + std::fabs(n[1]) + std::fabs(n[2]);
+	float x = 1.0f, y = 0.0f;
+	if (l1 > 0.0f)
+	{
+		x = n[0] / l1;
+		y = n[1] / l1;
+		if (n[2] < 0.0f)
+		{
+			float fx = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+			float fy = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+			x = fx;
+			y = fy;
+		}
+	}
+	out[0] = (int16_t)std::lround(std::fmin(std::fmax(x, -1.0f), 1.0f) * 32767.0f);
+	out[1] = (int16_t)std::lround(std::fmin(std::fmax(y, -1.0f), 1.0f) * 32767.0f);
+}
+
+// 按布局描述读取任意内存中的顶点：各属性可以交错存放，也可以各自成流，
+// 内存可以是Buffer<float>、std::vector或映射的文件，不必先拷贝成Vertex数组
+// 下标访问时现场组装出一个Vertex交给顶点着色器，可直接作为draw的顶点数组
+// 压缩格式在取顶点时解码，顶点着色器看到的仍是浮点属性
+template<typename Vertex>
+class VertexView
+{
+public:
+	VertexView() {}
+	VertexView(size_t count): count(count) {}
+
+	// member为Vertex中接收该属性的成员，data + offset为第0个顶点该属性的地址
+	// VERTEX_UNORM16需要给出每个分量的scale与offset
+	template<int N>
+	void bind(Vec<N> Vertex::*member, const void *data, size_t offset, size_t stride, int format = VERTEX_FLOAT,
+		const float *scale = nullptr, const float *bias = nullptr)
+	{
+		Vertex probe;
+
+		VertexAttribute attribute;
+		attribute.data = (const BYTE*)data + offset;
+		attribute.stride = stride;
+		attribute.format = format;
+		attribute.components = N;
+		attribute.target = (const BYTE*)&(probe.*member) - (const BYTE*)&probe;
+		for (int i = 0; i < N && i < 4; i++)
+		{
+			if (scale != nullptr) attribute.scale[i] = scale[i];
+			if (bias != nullptr) attribute.offset[i] = bias[i];
+		}
+		attributes.push_back(attribute);
+	}
+
+	Vertex operator [] (size_t index)
+	{
+		Vertex vertex;
+		for (auto& attribute : attributes)
+		{
+			fetch(attribute, index, (float*)((BYTE*)&vertex + attribute.target));
+		}
+		return vertex;
+	}
+
+	size_t size() { return count; }
+	bool empty() { return count == 0; }
+
+	size_t count = 0;
+
+private:
+	static void fetch(VertexAttribute& attribute, size_t index, float *out)
+	{
+		const BYTE *src = attribute.data + index * attribute.stride;
+
+		switch (attribute.format)
+		{
+			case VERTEX_UNORM16:
+				decodeUnorm16(attribute, src, out);
+				break;
+			case VERTEX_OCT16:
+				decodeOctahedral(src, out);
+				break;
+			case VERTEX_FLOAT:
+			default:
+				memcpy(out, src, attribute.components * sizeof(float));
+				break;
+		}
+	}
+
+	// 分量先拷到临时区，SSE读写4个分量不会越过属性或顶点的边界
+	static void decodeUnorm16(VertexAttribute& attribute, const BYTE *src, float *out)
+	{
+		int n = attribute.components;
+
+#ifdef VERTEX_LAYOUT_SSE2
+		uint16_t q[8] = {};
+		memcpy(q, src, n * sizeof(uint16_t));
+
+		__m128i wide = _mm_unpacklo_epi16(_mm_loadl_epi64((__m128i*)q), _mm_setzero_si128());
+		__m128 v = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(wide), _mm_loadu_ps(attribute.scale)), _mm_loadu_ps(attribute.offset));
+
+		float result[4];
+		_mm_storeu_ps(result, v);
+		memcpy(out, result, n * sizeof(float));
+#else
+		uint16_t q[4];
+		memcpy(q, src, n * sizeof(uint16_t));
+		for (int i = 0; i < n; i++) out[i] = attribute.offset[i] + q[i] * attribute.scale[i];
+#endif
+	}
+
+	// 分支无关的八面体解码：z = 1 - |x| - |y|，z < 0时x、y的绝对值各减去-z（折回下半球），再归一化
+	static void decodeOctahedral(const BYTE *src, float *out)
+	{
+		int16_t q[2];
+		memcpy(q, src, sizeof(q));
+
+#ifdef VERTEX_LAYOUT_SSE2
+		__m128 signMask = _mm_set1_ps(-0.0f);
+		__m128 xy = _mm_max_ps(_mm_mul_ps(_mm_set_ps(0.0f, 0.0f, (float)q[1], (float)q[0]), _mm_set1_ps(1.0f / 32767.0f)), _mm_set1_ps(-1.0f));
+
+		__m128 absXY = _mm_andnot_ps(signMask, xy);
+		float z = 1.0f - _mm_cvtss_f32(absXY) - _mm_cvtss_f32(_mm_shuffle_ps(absXY, absXY, 1));
+
+		// t = max(-z, 0)，x、y各减去与自身同号的t
+		__m128 t = _mm_set_ps(0.0f, 0.0f, std::fmax(-z, 0.0f), std::fmax(-z, 0.0f));
+		__m128 v = _mm_add_ps(xy, _mm_xor_ps(_mm_xor_ps(t, signMask), _mm_and_ps(xy, signMask)));
+		v = _mm_shuffle_ps(v, _mm_set_ss(z), _MM_SHUFFLE(1, 0, 1, 0));
+
+		__m128 sq = _mm_mul_ps(v, v);
+		__m128 sum = _mm_add_ss(_mm_add_ss(sq, _mm_shuffle_ps(sq, sq, 1)), _mm_shuffle_ps(sq, sq, 2));
+		__m128 length = _mm_sqrt_ss(sum);
+		v = _mm_div_ps(v, _mm_shuffle_ps(length, length, 0));
+
+		float result[4];
+		_mm_storeu_ps(result, v);
+		memcpy(out, result, 3 * sizeof(float));
+#else
+		float x = std::fmax(q[0] / 32767.0f, -1.0f);
+		float y = std::fmax(q[1] / 32767.0f, -1.0f);
+		float z = 1.0f - std::fabs(x) - std::fabs(y);
+		float t = std::fmax(-z, 0.0f);
+		x += (x >= 0.0f) ? -t : t;
+		y += (y >= 0.0f) ? -t : t;
+
+		float length = std::sqrt(x * x + y * y + z * z);
+		out[0] = x / length;
+		out[1] = y / length;
+		out[2] = z / length;
+#endif
+	}
+
+	std::vector<VertexAttribute> attributes;
+};
+
+#endif
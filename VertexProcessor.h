@@ -4,6 +4,9 @@
 #define VERTEXPROCESSOR_H
 
 #include <vector>
+#include <thread>
+#include <algorithm>
+#include <cmath>
 
 #include "math/Vector.h"
 #include "math/Matrix.h"
@@ -11,30 +14,66 @@
 #include "Shader.h"
 #include "Primitive.h"
 #include "PipelineData.h"
+#include "Arena.h"
 
 const float CLIP_NEARPLANE_EPS = 1e-10;
+const int CLIP_MAX_POLYGON_SIZE = 9;
 
 class VertexProcessor
 {
 public:
-	template<typename Shader>
-	static std::vector<Pipeline::FSIn<typename Shader::VSToFS>> processVertex(
-			std::vector<typename Shader::VSIn>& vertexIn,
+	// 顶点数组与索引数组只要求size()与下标访问，可以是std::vector或指向映射文件的ArrayView
+	template<typename Shader, typename VertexArray, typename IndexArray = std::vector<UINT>>
+	static ArenaVector<Pipeline::FSIn<typename Shader::VSToFS>> processVertex(
+			VertexArray& vertexIn,
 			Shader& shader,
 			Vec2 viewportSize,
 			int primitiveType,
-			std::vector<UINT> *indices = nullptr)
+			FrameArena& arena,
+			IndexArray *indices = nullptr)
 	{
-		std::vector<Pipeline::FSIn<typename Shader::VSToFS>> outData;
-		std::vector<Pipeline::VSOut<typename Shader::VSToFS>> clipped;
-		std::vector<Pipeline::VSOut<typename Shader::VSToFS>> clipSpaceData;
+		ArenaVector<Pipeline::FSIn<typename Shader::VSToFS>> outData(arena);
+		ArenaVector<Pipeline::VSOut<typename Shader::VSToFS>> clipped(arena);
+		ArenaVector<Pipeline::VSOut<typename Shader::VSToFS>> clipSpaceData(arena);
 
 		int vertexCount = (indices == nullptr) ? vertexIn.size() : indices->size();
+		clipSpaceData.reserve(vertexCount);
+
+		// 后变换缓存：带索引时记住最近VERTEX_CACHE_SIZE个不同索引的输出位置（先进先出），
+		// 命中时直接复制已有结果而不再调用顶点着色器，三角形顺序的局部性越好命中越多
+		UINT cacheIndex[VERTEX_CACHE_SIZE];
+		int cachePosition[VERTEX_CACHE_SIZE];
+		int cacheHead = 0;
+		for (int c = 0; c < VERTEX_CACHE_SIZE; c++) cacheIndex[c] = VERTEX_CACHE_EMPTY;
 
 		for (register int i = 0; i < vertexCount; i++)
 		{
 			UINT index = (indices == nullptr) ? i : (*indices)[i];
-			clipSpaceData.push_back(shader.processVertex(vertexIn[index]));
+
+			if (indices != nullptr)
+			{
+				int hit = -1;
+				for (int c = 0; c < VERTEX_CACHE_SIZE; c++)
+				{
+					if (cacheIndex[c] == index)
+					{
+						hit = cachePosition[c];
+						break;
+					}
+				}
+				if (hit >= 0)
+				{
+					clipSpaceData.push_back(clipSpaceData[hit]);
+					continue;
+				}
+
+				cacheIndex[cacheHead] = index;
+				cachePosition[cacheHead] = clipSpaceData.size();
+				cacheHead = (cacheHead + 1) % VERTEX_CACHE_SIZE;
+			}
+
+			auto&& in = vertexIn[index];
+			clipSpaceData.push_back(shader.processVertex(in));
 		}
 
 		/*std::cout << "Input:\n";
@@ -48,7 +87,7 @@ public:
 			case Primitive::LINE:
 				break;
 			case Primitive::TRIANGLE:
-				clipped = doClipping(clipSpaceData);
+				doClipping(clipped, clipSpaceData);
 				break;
 			case Primitive::POINT:
 			default:
@@ -57,6 +96,8 @@ public:
 
 		//std::cout << "Output  " << clipped.size() << "\n";
 
+		outData.reserve(clipped.size());
+
 		for (register int i = 0; i < clipped.size(); i++)
 		{
 			Vec4& pos = clipped[i].sr_Position;
@@ -77,78 +118,224 @@ public:
 		return outData;
 	}
 
+	// 只求sr_Position的顶点路径，供只写深度的pass使用，裁剪与光栅化时不插值任何varying
+	// 着色器提供Vec4 processPosition(VSIn&)时调用它，否则取processVertex结果中的sr_Position
+	template<typename Shader, typename VertexArray, typename IndexArray = std::vector<UINT>>
+	static ArenaVector<Pipeline::FSIn<Pipeline::NoVaryings>> processPosition(
+			VertexArray& vertexIn,
+			Shader& shader,
+			Vec2 viewportSize,
+			FrameArena& arena,
+			IndexArray *indices = nullptr)
+	{
+		PositionShader<Shader> positionShader{ shader };
+		return processVertex(vertexIn, positionShader, viewportSize, Primitive::TRIANGLE, arena, indices);
+	}
+
+	// 把顶点数组按下标取成连续的VSIn，实例化绘制时各实例共用，压缩格式只解码一次
+	template<typename VSIn, typename VertexArray>
+	static ArenaVector<VSIn> fetchVertices(VertexArray& vertexIn, FrameArena& arena)
+	{
+		ArenaVector<VSIn> fetched(arena);
+		fetched.reserve(vertexIn.size());
+		for (size_t i = 0; i < vertexIn.size(); i++) fetched.push_back(vertexIn[i]);
+		return fetched;
+	}
+
+	// 实例化的顶点阶段：实例平均分给各线程，每个实例用一份调用过setInstance(instances, i)的着色器副本
+	// 跑完整的顶点变换与裁剪，结果按实例顺序拼接，所有实例的三角形之后一起光栅化
+	template<typename Shader, typename VertexArray, typename Instance, typename IndexArray = std::vector<UINT>>
+	static ArenaVector<Pipeline::FSIn<typename Shader::VSToFS>> processInstances(
+			VertexArray& vertexIn,
+			Shader& shader,
+			Instance *instances,
+			int instanceCount,
+			Vec2 viewportSize,
+			FrameArena& arena,
+			IndexArray *indices = nullptr)
+	{
+		return forEachInstance<Pipeline::FSIn<typename Shader::VSToFS>>(shader, instances, instanceCount, arena, [&](Shader& local)
+		{
+			return processVertex(vertexIn, local, viewportSize, Primitive::TRIANGLE, arena, indices);
+		});
+	}
+
+	// processInstances的只求位置版本，供实例化绘制的深度预pass使用
+	template<typename Shader, typename VertexArray, typename Instance, typename IndexArray = std::vector<UINT>>
+	static ArenaVector<Pipeline::FSIn<Pipeline::NoVaryings>> processInstancePositions(
+			VertexArray& vertexIn,
+			Shader& shader,
+			Instance *instances,
+			int instanceCount,
+			Vec2 viewportSize,
+			FrameArena& arena,
+			IndexArray *indices = nullptr)
+	{
+		return forEachInstance<Pipeline::FSIn<Pipeline::NoVaryings>>(shader, instances, instanceCount, arena, [&](Shader& local)
+		{
+			return processPosition(vertexIn, local, viewportSize, arena, indices);
+		});
+	}
+
 private:
+	template<typename Output, typename Shader, typename Instance, typename Process>
+	static ArenaVector<Output> forEachInstance(
+			Shader& shader,
+			Instance *instances,
+			int instanceCount,
+			FrameArena& arena,
+			Process process)
+	{
+		int threadCount = std::max(1, std::min((int)std::thread::hardware_concurrency(), instanceCount));
+
+		// 每个实例的结果单独保留，全部完成后按总数一次分配并只拷贝一遍
+		std::vector<ArenaVector<Output>> outputs(instanceCount, ArenaVector<Output>(arena));
+		std::vector<std::thread> threads;
+
+		for (int t = 0; t < threadCount; t++)
+		{
+			int start = (int)((long long)instanceCount * t / threadCount);
+			int end = (int)((long long)instanceCount * (t + 1) / threadCount);
+
+			threads.emplace_back([&, start, end]()
+			{
+				for (int i = start; i < end; i++)
+				{
+					Shader local = shader;
+					local.setInstance(instances, i);
+					outputs[i] = process(local);
+				}
+			});
+		}
+
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+
+		size_t count = 0;
+		for (auto& out : outputs) count += out.size();
+
+		ArenaVector<Output> outData(arena);
+		outData.reserve(count);
+		for (auto& out : outputs) outData.insert(outData.end(), out.begin(), out.end());
+		return outData;
+	}
+
+	template<typename Shader>
+	struct PositionShader
+	{
+		typedef typename Shader::VSIn VSIn;
+		typedef Pipeline::NoVaryings VSToFS;
+
+		Pipeline::VSOut<VSToFS> processVertex(VSIn& in)
+		{
+			Pipeline::VSOut<VSToFS> out;
+			out.sr_Position = position(shader, in, 0);
+			return out;
+		}
+
+		template<typename S>
+		static auto position(S& shader, VSIn& in, int) -> decltype(shader.processPosition(in))
+		{
+			return shader.processPosition(in);
+		}
+
+		template<typename S>
+		static Vec4 position(S& shader, VSIn& in, long)
+		{
+			return shader.processVertex(in).sr_Position;
+		}
+
+		Shader& shader;
+	};
+
 	template<typename VSToFS>
-	static std::vector<Pipeline::VSOut<VSToFS>> doClipping(
-			std::vector<Pipeline::VSOut<VSToFS>>& clipSpaceData)
+	static void doClipping(
+			ArenaVector<Pipeline::VSOut<VSToFS>>& clipResult,
+			ArenaVector<Pipeline::VSOut<VSToFS>>& clipSpaceData)
 	{
 		int triangleCount = clipSpaceData.size() / 3;
-		std::vector<Pipeline::VSOut<VSToFS>> clipResult;
+		clipResult.reserve(clipSpaceData.size());
 
 		for (register int i = 0; i < triangleCount; i++)
 		{
-			Pipeline::VSOut<VSToFS> va = clipSpaceData[i * 3 + 0];
-			Pipeline::VSOut<VSToFS> vb = clipSpaceData[i * 3 + 1];
-			Pipeline::VSOut<VSToFS> vc = clipSpaceData[i * 3 + 2];
+			Pipeline::VSOut<VSToFS>& va = clipSpaceData[i * 3 + 0];
+			Pipeline::VSOut<VSToFS>& vb = clipSpaceData[i * 3 + 1];
+			Pipeline::VSOut<VSToFS>& vc = clipSpaceData[i * 3 + 2];
 
-			std::vector<Pipeline::VSOut<VSToFS>> clipped = clipTriangle(va, vb, vc);
-
-			clipResult.insert(clipResult.end(), clipped.begin(), clipped.end());
+			clipTriangle(clipResult, va, vb, vc);
 		}
-
-		return clipResult;
 	}
 
+	// 三角形被6个平面裁剪后最多剩下9个顶点，用定长数组来回倒，不做堆分配
 	template<typename VSToFS>
-	static std::vector<Pipeline::VSOut<VSToFS>> clipTriangle(
+	static void clipTriangle(
+			ArenaVector<Pipeline::VSOut<VSToFS>>& res,
 			Pipeline::VSOut<VSToFS>& v0,
 			Pipeline::VSOut<VSToFS>& v1,
 			Pipeline::VSOut<VSToFS>& v2)
 	{
-		std::vector<Pipeline::VSOut<VSToFS>> output = { v0, v1, v2 };
+		// 退化的变换（如视线与up平行）会算出NaN，比较全为假会被当作在视锥内，
+		// 之后转成的屏幕坐标没有意义，光栅化时可能按巨大的包围盒分配内存，整个三角形丢弃
+		if (!finite(v0.sr_Position) || !finite(v1.sr_Position) || !finite(v2.sr_Position)) return;
 
 		if (areaCode(v0.sr_Position) == INSIDE 
 				&& areaCode(v1.sr_Position) == INSIDE
 				&& areaCode(v2.sr_Position) == INSIDE)
 		{
-			return output;
+			res.push_back(v0);
+			res.push_back(v1);
+			res.push_back(v2);
+			return;
 		}
 
+		Pipeline::VSOut<VSToFS> polygon[2][CLIP_MAX_POLYGON_SIZE];
+		int size[2] = { 3, 0 };
+		int cur = 0;
+
+		polygon[0][0] = v0;
+		polygon[0][1] = v1;
+		polygon[0][2] = v2;
+
 		for (int i = 0; i < 6; i++)
 		{
-			std::vector<Pipeline::VSOut<VSToFS>> input(output);
-			output.clear();
+			Pipeline::VSOut<VSToFS> *input = polygon[cur];
+			Pipeline::VSOut<VSToFS> *output = polygon[cur ^ 1];
+			int inputSize = size[cur];
+			int outputSize = 0;
 
-			for (register int j = 0; j < input.size(); j++)
+			for (register int j = 0; j < inputSize; j++)
 			{
-				Pipeline::VSOut<VSToFS> va = input[j];
-				Pipeline::VSOut<VSToFS> vb = input[(j + 1) % input.size()];
+				Pipeline::VSOut<VSToFS>& va = input[j];
+				Pipeline::VSOut<VSToFS>& vb = input[(j + 1) % inputSize];
 
 				if (inside(vb.sr_Position, planeNorms[i]))
 				{
 					if (!inside(va.sr_Position, planeNorms[i]))
 					{
-						output.push_back(intersect(va, vb, planeNorms[i]));
+						output[outputSize++] = intersect(va, vb, planeNorms[i]);
 					}
-					output.push_back(vb);
+					output[outputSize++] = vb;
 				}
 				else if (inside(va.sr_Position, planeNorms[i]))
 				{
-					output.push_back(intersect(va, vb, planeNorms[i]));
+					output[outputSize++] = intersect(va, vb, planeNorms[i]);
 				}
 			}
+
+			size[cur ^ 1] = outputSize;
+			cur ^= 1;
 		}
 
-		std::vector<Pipeline::VSOut<VSToFS>> res;
+		Pipeline::VSOut<VSToFS> *output = polygon[cur];
 
-		for (register int i = 1; i + 1 < output.size(); i++)
+		for (register int i = 1; i + 1 < size[cur]; i++)
 		{
 			res.push_back(output[0]);
 			res.push_back(output[i]);
 			res.push_back(output[i + 1]);
 		}
-
-		return res;
 	}
 
 	static bool inside(Vec4 plane, Vec4 pos)
@@ -170,6 +357,11 @@ private:
 		return out;
 	}
 
+	static bool finite(Vec4& pos)
+	{
+		return std::isfinite(pos[0]) && std::isfinite(pos[1]) && std::isfinite(pos[2]) && std::isfinite(pos[3]);
+	}
+
 	static int areaCode(Vec4 pos)
 	{
 		int code = INSIDE;
@@ -0,0 +1,20 @@
+#include "HeadlessApplication.h"
+
+HeadlessApplication app;
+
+int main(int argc, char **argv)
+{
+	HeadlessOptions options;
+
+	if (!options.parse(argc, argv))
+	{
+		HeadlessOptions::printUsage(argv[0]);
+		return 1;
+	}
+
+	if (!app.init(options)) return 1;
+
+	app.run();
+
+	return 0;
+}
@@ -36,7 +36,11 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR szCmdLine,
 	int width, height;
 	std::cout << "Input Window Size\n";
 	std::cin >> width >> height;
-	app.init(std::string(name), hInstance, width, height);
+	if (!app.init(std::string(name), hInstance, width, height))
+	{
+		MessageBoxA(nullptr, "Failed to load render data", name, MB_ICONERROR);
+		return 0;
+	}
 
 	while (true)
 	{
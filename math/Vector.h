@@ -242,7 +242,7 @@ bool equals(Vec<N>& a, Vec<N>& b, float eps)
 	bool equal = true;
 	for (int i = 0; i < N; i++)
 	{
-		if (abs(a[i] - b[i]) > eps) equal = false;
+		if (std::abs(a[i] - b[i]) > eps) equal = false;
 	}
 	return equal;
 }